@@ -0,0 +1,281 @@
+/*
+ * A grid of allocation workloads run against each of the general allocators in the repo and the
+ * standard library alternatives. Every allocator is run for each combination of object size, the
+ * order that objects are released in and thread count, so that one table (or, with --json, one
+ * file) shows how they compare across all of them.
+ *
+ * As well as throughput, the latency of operations is sampled so that the median and 99th
+ * percentile can be reported. Timing every single allocation would mostly measure the clock, so
+ * operations are timed in small batches and each batch contributes its average as one sample.
+ *
+ * PoolAllocator, TrackingAllocator and unsynchronized_pool_resource aren't thread safe, so each
+ * thread gets its own instance. new/delete, malloc, TrackingAllocator with sharded counters and
+ * synchronized_pool_resource are shared by all of the threads, so the thread counts show how well
+ * they cope with contention.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "Allocators/PoolAllocator.h"
+#include "Allocators/TrackingAllocator.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	// The number of objects allocated before they're all released again.
+	const size_t LIVE_ITEMS = 1024;
+	const int ROUNDS = 200;
+	// The number of operations timed together to make one latency sample.
+	const size_t SAMPLE_BATCH = 32;
+
+	template<size_t size>
+	struct Object
+	{
+		char data[size];
+	};
+
+	enum class ReleaseOrder
+	{
+		// Released in the reverse of the order they were allocated, like a stack.
+		LIFO,
+		// Released in the order they were allocated, like a queue.
+		FIFO,
+		// Released in a random order.
+		RANDOM
+	};
+
+	const char* getOrderName(ReleaseOrder order)
+	{
+		switch (order)
+		{
+		case ReleaseOrder::LIFO: return "LIFO";
+		case ReleaseOrder::FIFO: return "FIFO";
+		default: return "Random";
+		}
+	}
+
+	// The allocators all have the same interface so the workload can be written once. Shared is
+	// the state used by every thread and Local is created by each thread for its own use.
+
+	template<class T>
+	struct NewDelete
+	{
+		static const char* getName() { return "new/delete"; }
+		struct Shared {};
+		struct Local
+		{
+			explicit Local(Shared&) {}
+			T* allocate() { return new T; }
+			void deallocate(T* pItem) { delete pItem; }
+		};
+	};
+
+	template<class T>
+	struct Malloc
+	{
+		static const char* getName() { return "malloc/free"; }
+		struct Shared {};
+		struct Local
+		{
+			explicit Local(Shared&) {}
+			T* allocate() { return static_cast<T*>(malloc(sizeof(T))); }
+			void deallocate(T* pItem) { free(pItem); }
+		};
+	};
+
+	template<class T>
+	struct Pool
+	{
+		static const char* getName() { return "PoolAllocator"; }
+		struct Shared {};
+		struct Local
+		{
+			explicit Local(Shared&) : pool(new PoolAllocator<T, LIVE_ITEMS>()) {}
+			T* allocate() { return pool->construct(); }
+			void deallocate(T* pItem) { pool->destruct(pItem); }
+			// Too big for the stack with the larger objects.
+			std::unique_ptr<PoolAllocator<T, LIVE_ITEMS>> pool;
+		};
+	};
+
+	template<class T>
+	struct Tracking
+	{
+		static const char* getName() { return "TrackingAllocator"; }
+		struct Shared {};
+		struct Local
+		{
+			explicit Local(Shared&) {}
+			T* allocate() { return allocator.allocate(1); }
+			void deallocate(T* pItem) { allocator.deallocate(pItem); }
+			TrackingAllocator<T> allocator;
+		};
+	};
+
+	template<class T>
+	struct ShardedTracking
+	{
+		static const char* getName() { return "TrackingAllocator (sharded)"; }
+		typedef TrackingAllocator<T, 0, ShardedTrackingCounters> Shared;
+		struct Local
+		{
+			explicit Local(Shared& allocator) : allocator(allocator) {}
+			T* allocate() { return allocator.allocate(1); }
+			void deallocate(T* pItem) { allocator.deallocate(pItem); }
+			Shared& allocator;
+		};
+	};
+
+	template<class T>
+	struct UnsynchronizedPmr
+	{
+		static const char* getName() { return "unsynchronized_pool_resource"; }
+		struct Shared {};
+		struct Local
+		{
+			explicit Local(Shared&) {}
+			T* allocate() { return static_cast<T*>(resource.allocate(sizeof(T), alignof(T))); }
+			void deallocate(T* pItem) { resource.deallocate(pItem, sizeof(T), alignof(T)); }
+			std::pmr::unsynchronized_pool_resource resource;
+		};
+	};
+
+	template<class T>
+	struct SynchronizedPmr
+	{
+		static const char* getName() { return "synchronized_pool_resource"; }
+		typedef std::pmr::synchronized_pool_resource Shared;
+		struct Local
+		{
+			explicit Local(Shared& resource) : resource(resource) {}
+			T* allocate() { return static_cast<T*>(resource.allocate(sizeof(T), alignof(T))); }
+			void deallocate(T* pItem) { resource.deallocate(pItem, sizeof(T), alignof(T)); }
+			Shared& resource;
+		};
+	};
+
+	// The order to release the live items in, as indices into the order they were allocated.
+	std::vector<size_t> getReleaseOrder(ReleaseOrder order, unsigned int seed)
+	{
+		std::vector<size_t> indices(LIVE_ITEMS);
+		for (size_t i = 0; i < LIVE_ITEMS; i++)
+			indices[i] = order == ReleaseOrder::LIFO ? LIVE_ITEMS - 1 - i : i;
+		if (order == ReleaseOrder::RANDOM)
+		{
+			std::mt19937 random(seed);
+			std::shuffle(indices.begin(), indices.end(), random);
+		}
+		return indices;
+	}
+
+	// Each round allocates LIVE_ITEMS objects, touching each one, and then releases them all in
+	// the given order. Both allocations and releases count as operations.
+	template<class Allocator>
+	void runWorkload(const std::string& name, ReleaseOrder order, unsigned int threads)
+	{
+		typedef typename Allocator::Shared Shared;
+		typedef typename Allocator::Local Local;
+
+		Shared shared;
+		std::vector<std::vector<double>> threadLatencies(threads);
+		std::vector<Clock::time_point> starts(threads), ends(threads);
+		std::atomic<unsigned int> ready(0);
+		runThreads(threads, [&](unsigned int t) {
+			Local allocator(shared);
+			auto release = getReleaseOrder(order, t + 1);
+			auto& latencies = threadLatencies[t];
+			latencies.reserve(ROUNDS * 2 * LIVE_ITEMS / SAMPLE_BATCH);
+			std::vector<decltype(allocator.allocate())> items(LIVE_ITEMS);
+
+			// Only the operations are timed, not setting up or tearing down the allocators, so every
+			// thread finishes setting up before any of them start.
+			ready++;
+			while (ready.load() != threads) std::this_thread::yield();
+			starts[t] = Clock::now();
+			for (int round = 0; round < ROUNDS; round++)
+			{
+				for (size_t i = 0; i < LIVE_ITEMS; i += SAMPLE_BATCH)
+				{
+					auto start = Clock::now();
+					for (size_t j = i; j < i + SAMPLE_BATCH; j++)
+					{
+						items[j] = allocator.allocate();
+						items[j]->data[0] = (char)j;
+					}
+					latencies.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / SAMPLE_BATCH);
+				}
+				doNotOptimise(items[0]);
+				for (size_t i = 0; i < LIVE_ITEMS; i += SAMPLE_BATCH)
+				{
+					auto start = Clock::now();
+					for (size_t j = i; j < i + SAMPLE_BATCH; j++)
+						allocator.deallocate(items[release[j]]);
+					latencies.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / SAMPLE_BATCH);
+				}
+			}
+			ends[t] = Clock::now();
+		});
+		double seconds = std::chrono::duration<double>(*std::max_element(ends.begin(), ends.end()) - *std::min_element(starts.begin(), starts.end())).count();
+
+		std::vector<double> latencies;
+		for (auto& samples : threadLatencies)
+			latencies.insert(latencies.end(), samples.begin(), samples.end());
+		reportLatency(name, threads, (size_t)threads * ROUNDS * LIVE_ITEMS * 2, seconds, latencies);
+	}
+
+	// Always includes 2 and 4 threads, even on machines with fewer cores, as how the shared
+	// allocators behave when threads are preempted while holding a lock is worth seeing too.
+	std::vector<unsigned int> getThreadCounts()
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		std::vector<unsigned int> counts = { 1, 2, 4 };
+		for (unsigned int threads = 8; threads <= cores && threads <= 32; threads *= 2)
+			counts.push_back(threads);
+		return counts;
+	}
+
+	template<size_t size, template<class> class... Allocators>
+	void runSize()
+	{
+		for (ReleaseOrder order : { ReleaseOrder::LIFO, ReleaseOrder::FIFO, ReleaseOrder::RANDOM })
+		{
+			for (unsigned int threads : getThreadCounts())
+			{
+				// Expands to one call per allocator.
+				int expand[] = { (runWorkload<Allocators<Object<size>>>(
+					std::string(Allocators<Object<size>>::getName()) + " " + std::to_string(size) + "B " + getOrderName(order),
+					order, threads), 0)... };
+				(void)expand;
+			}
+		}
+	}
+
+	template<size_t size>
+	void runAllAllocators()
+	{
+		runSize<size, NewDelete, Malloc, Pool, Tracking, ShardedTracking, UnsynchronizedPmr, SynchronizedPmr>();
+	}
+}
+
+BENCHMARK(Allocator_Suite_16B)
+{
+	runAllAllocators<16>();
+}
+
+BENCHMARK(Allocator_Suite_64B)
+{
+	runAllAllocators<64>();
+}
+
+BENCHMARK(Allocator_Suite_256B)
+{
+	runAllAllocators<256>();
+}
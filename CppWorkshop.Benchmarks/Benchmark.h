@@ -0,0 +1,95 @@
+/*
+ * A minimal benchmark harness. Benchmarks register themselves with the BENCHMARK macro and are
+ * run by main(). Each benchmark times its own work and reports the results through
+ * Benchmark::report so that output stays consistent between benchmarks. Passing --json <file> on
+ * the command line also writes every result to the file as JSON for other tools to consume.
+ *
+ * This is deliberately simple, it's here to give ballpark comparisons between allocators rather
+ * than to be a replacement for a proper benchmarking library.
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Benchmark
+{
+	typedef std::chrono::steady_clock Clock;
+	typedef std::function<void()> BenchmarkFunc;
+
+	struct Registration
+	{
+		const char* name;
+		BenchmarkFunc func;
+	};
+
+	std::vector<Registration>& registry();
+
+	struct Registrar
+	{
+		Registrar(const char* name, BenchmarkFunc func)
+		{
+			registry().push_back({ name, func });
+		}
+	};
+
+	// Reports the result of a single benchmark run. Operations is the total number of operations
+	// performed across all threads.
+	void report(const std::string& name, unsigned int threads, size_t operations, double seconds);
+
+	// Reports a run that also sampled the latency of individual operations, in nanoseconds. Prints
+	// the median and 99th percentile alongside the throughput.
+	void reportLatency(const std::string& name, unsigned int threads, size_t operations, double seconds, std::vector<double> latencies);
+
+	// Reports the memory used by a container or allocator holding the given number of items.
+	void reportMemory(const std::string& name, size_t bytes, size_t items);
+
+	inline double secondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Runs func(threadIndex) on the requested number of threads and returns the elapsed wall
+	// clock time in seconds. The threads are all created before the clock starts and are
+	// released together so that thread start up costs aren't included in the measurement.
+	template<class Func>
+	double runThreads(unsigned int threadCount, Func func)
+	{
+		std::atomic<unsigned int> ready(0);
+		std::atomic<bool> go(false);
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < threadCount; i++)
+		{
+			threads.emplace_back([&, i]() {
+				ready++;
+				while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+				func(i);
+			});
+		}
+		while (ready.load() != threadCount) std::this_thread::yield();
+
+		auto start = Clock::now();
+		go.store(true, std::memory_order_release);
+		for (auto& thread : threads) thread.join();
+		return secondsSince(start);
+	}
+
+	// Written to by doNotOptimise. The pointer itself must be volatile, otherwise the store can
+	// still be optimised away.
+	extern const void* volatile g_sink;
+
+	// Prevents the compiler from optimising away a value that is otherwise unused.
+	template<class T>
+	inline void doNotOptimise(const T& value)
+	{
+		g_sink = &value;
+	}
+}
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static Benchmark::Registrar name##_registrar(#name, &name); \
+	static void name()
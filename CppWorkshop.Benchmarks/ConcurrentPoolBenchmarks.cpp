@@ -0,0 +1,27 @@
+/*
+ * Compares the throughput of ConcurrentPoolAllocator against the original PoolAllocator wrapped in
+ * a mutex when several threads share a single pool.
+ */
+#include "PoolBenchmarks.h"
+#include "Allocators/ConcurrentPoolAllocator.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	const size_t POOL_SIZE = 1024;
+	const int BATCH_SIZE = 8;
+	const int ITERATIONS = 200000;
+	const unsigned int THREAD_COUNTS[] = { 1, 2, 4, 8 };
+
+	LockedPoolAllocator<PoolItem, POOL_SIZE> s_lockedPool;
+	ConcurrentPoolAllocator<PoolItem, POOL_SIZE> s_concurrentPool;
+}
+
+BENCHMARK(ConcurrentPool_vs_MutexPool)
+{
+	for (auto threads : THREAD_COUNTS)
+		churnPool<BATCH_SIZE>("PoolAllocator + std::mutex", s_lockedPool, threads, ITERATIONS);
+	for (auto threads : THREAD_COUNTS)
+		churnPool<BATCH_SIZE>("ConcurrentPoolAllocator", s_concurrentPool, threads, ITERATIONS);
+}
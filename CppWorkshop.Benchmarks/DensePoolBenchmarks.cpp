@@ -0,0 +1,59 @@
+/*
+ * Compares the memory footprint of PoolAllocator and DensePoolAllocator, and how quickly a full
+ * pool of small items can be scanned in address order.
+ */
+#include <algorithm>
+#include <vector>
+#include "PoolBenchmarks.h"
+#include "Allocators/DensePoolAllocator.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	const size_t POOL_SIZE = 60000;
+	const int SCANS = 200;
+
+	PoolAllocator<PoolItem, POOL_SIZE> s_pool;
+	DensePoolAllocator<PoolItem, POOL_SIZE> s_densePool;
+
+	template<class Pool>
+	void scanPool(const char* name, Pool& pool)
+	{
+		// Fill the pool and sort the items by address so that the scan walks forwards through
+		// memory the same way a batch update over all of the pooled items would.
+		std::vector<PoolItem*> items;
+		for (size_t i = 0; i < POOL_SIZE; i++)
+			items.push_back(pool.construct((int)i, 1, 2));
+		std::sort(items.begin(), items.end(), std::less<PoolItem*>());
+
+		long long total = 0;
+		auto start = Clock::now();
+		for (int scan = 0; scan < SCANS; scan++)
+		{
+			for (auto pItem : items)
+			{
+				pItem->x++;
+				total += pItem->y + pItem->z;
+			}
+		}
+		double seconds = secondsSince(start);
+		doNotOptimise(total);
+		report(name, 1, POOL_SIZE * SCANS, seconds);
+
+		for (auto pItem : items)
+			pool.destruct(pItem);
+	}
+}
+
+BENCHMARK(DensePool_Footprint)
+{
+	reportMemory("PoolAllocator", sizeof(s_pool), POOL_SIZE);
+	reportMemory("DensePoolAllocator", sizeof(s_densePool), POOL_SIZE);
+}
+
+BENCHMARK(DensePool_Linear_Scan)
+{
+	scanPool("PoolAllocator", s_pool);
+	scanPool("DensePoolAllocator", s_densePool);
+}
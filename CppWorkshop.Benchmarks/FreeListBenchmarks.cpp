@@ -0,0 +1,65 @@
+/*
+ * Compares the PoolAllocator free list orders. After some random churn, each pool allocates a
+ * batch of items and we time both the allocations and then repeatedly walking the items in the
+ * order they were allocated, as a system updating its components would.
+ */
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "PoolBenchmarks.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	// Large enough that the pool doesn't fit in the cache.
+	const size_t POOL_SIZE = 1000000;
+	const int PASSES = 20;
+
+	PoolAllocator<PoolItem, POOL_SIZE, 0, DefaultPoolChecks, LifoFreeList> s_lifoPool;
+	PoolAllocator<PoolItem, POOL_SIZE, 0, DefaultPoolChecks, FifoFreeList> s_fifoPool;
+	PoolAllocator<PoolItem, POOL_SIZE, 0, DefaultPoolChecks, AddressOrderedFreeList> s_orderedPool;
+
+	template<class Pool>
+	void churnAndIterate(const std::string& name, Pool& pool)
+	{
+		// Fill the pool then release a random half of it.
+		std::vector<PoolItem*> items;
+		for (size_t i = 0; i < POOL_SIZE; i++)
+			items.push_back(pool.construct((int)i, 1, 2));
+		std::mt19937 random(1234);
+		std::shuffle(items.begin(), items.end(), random);
+		for (size_t i = POOL_SIZE / 2; i < POOL_SIZE; i++)
+			pool.destruct(items[i]);
+		items.resize(POOL_SIZE / 2);
+
+		// Allocate the released half again.
+		std::vector<PoolItem*> allocated;
+		allocated.reserve(POOL_SIZE / 2);
+		auto start = Clock::now();
+		for (size_t i = 0; i < POOL_SIZE / 2; i++)
+			allocated.push_back(pool.construct((int)i, 1, 2));
+		report(name + " construct", 1, POOL_SIZE / 2, secondsSince(start));
+
+		long long total = 0;
+		start = Clock::now();
+		for (int pass = 0; pass < PASSES; pass++)
+		{
+			for (auto pItem : allocated)
+			{
+				pItem->x++;
+				total += pItem->y;
+			}
+		}
+		doNotOptimise(total);
+		report(name + " iterate", 1, POOL_SIZE / 2 * PASSES, secondsSince(start));
+	}
+}
+
+BENCHMARK(Pool_Free_List_Order)
+{
+	churnAndIterate("LifoFreeList", s_lifoPool);
+	churnAndIterate("FifoFreeList", s_fifoPool);
+	churnAndIterate("AddressOrderedFreeList", s_orderedPool);
+}
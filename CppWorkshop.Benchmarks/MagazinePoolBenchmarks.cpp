@@ -0,0 +1,32 @@
+/*
+ * Measures how the thread safe pools scale with thread count. The magazine pool should stay close
+ * to flat as threads are added as most operations never leave the calling thread's cache.
+ */
+#include "PoolBenchmarks.h"
+#include "Allocators/ConcurrentPoolAllocator.h"
+#include "Allocators/MagazinePoolAllocator.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	// Enough room for every thread to have a full batch in use plus a full magazine cached.
+	const size_t POOL_SIZE = 4096;
+	const int BATCH_SIZE = 8;
+	const int ITERATIONS = 20000;
+	const unsigned int THREAD_COUNTS[] = { 1, 4, 16, 64 };
+
+	LockedPoolAllocator<PoolItem, POOL_SIZE> s_lockedPool;
+	ConcurrentPoolAllocator<PoolItem, POOL_SIZE> s_concurrentPool;
+	MagazinePoolAllocator<PoolItem, POOL_SIZE, 32> s_magazinePool;
+}
+
+BENCHMARK(MagazinePool_Thread_Scaling)
+{
+	for (auto threads : THREAD_COUNTS)
+		churnPool<BATCH_SIZE>("PoolAllocator + std::mutex", s_lockedPool, threads, ITERATIONS);
+	for (auto threads : THREAD_COUNTS)
+		churnPool<BATCH_SIZE>("ConcurrentPoolAllocator", s_concurrentPool, threads, ITERATIONS);
+	for (auto threads : THREAD_COUNTS)
+		churnPool<BATCH_SIZE>("MagazinePoolAllocator", s_magazinePool, threads, ITERATIONS);
+}
@@ -0,0 +1,82 @@
+/*
+ * Mixed size allocation workloads comparing malloc/free, std::pmr::unsynchronized_pool_resource and
+ * SizeClassPoolResource.
+ */
+#include <memory_resource>
+#include <random>
+#include <stdlib.h>
+#include <vector>
+#include "Benchmark.h"
+#include "Allocators/SizeClassPoolResource.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	const int LIVE_ITEMS = 1000;
+	const int ROUNDS = 1000;
+
+	// Random sizes between 8 and 1024 bytes, weighted towards the small end as most real programs
+	// are.
+	std::vector<size_t> randomSizes()
+	{
+		std::mt19937 random(1234);
+		std::geometric_distribution<int> shift(0.4);
+		std::uniform_int_distribution<size_t> offset(0, 7);
+		std::vector<size_t> sizes;
+		for (int i = 0; i < LIVE_ITEMS; i++)
+		{
+			int bits = shift(random);
+			if (bits > 7) bits = 7;
+			sizes.push_back((size_t)8 << bits | offset(random));
+		}
+		return sizes;
+	}
+
+	struct MallocAllocator
+	{
+		void* allocate(size_t bytes) { return malloc(bytes); }
+		void deallocate(void* pMem, size_t) { free(pMem); }
+	};
+
+	struct ResourceAllocator
+	{
+		std::pmr::memory_resource* pResource;
+		void* allocate(size_t bytes) { return pResource->allocate(bytes); }
+		void deallocate(void* pMem, size_t bytes) { pResource->deallocate(pMem, bytes); }
+	};
+
+	// Keeps a working set of allocations and each round releases and reallocates every other one,
+	// so the free lists of each size class are exercised in a shuffled order.
+	template<class Allocator>
+	void mixedSizes(const char* name, Allocator allocator, const std::vector<size_t>& sizes)
+	{
+		std::vector<void*> items(sizes.size());
+		auto start = Clock::now();
+		for (size_t i = 0; i < sizes.size(); i++)
+			items[i] = allocator.allocate(sizes[i]);
+		for (int round = 0; round < ROUNDS; round++)
+		{
+			for (size_t i = round & 1; i < sizes.size(); i += 2)
+			{
+				allocator.deallocate(items[i], sizes[i]);
+				items[i] = allocator.allocate(sizes[i]);
+			}
+		}
+		for (size_t i = 0; i < sizes.size(); i++)
+			allocator.deallocate(items[i], sizes[i]);
+		report(name, 1, sizes.size() * (ROUNDS / 2 + 1), secondsSince(start));
+	}
+}
+
+BENCHMARK(Pmr_Mixed_Sizes)
+{
+	auto sizes = randomSizes();
+	mixedSizes("malloc/free", MallocAllocator(), sizes);
+
+	std::pmr::unsynchronized_pool_resource stdPool;
+	mixedSizes("unsynchronized_pool_resource", ResourceAllocator{ &stdPool }, sizes);
+
+	SizeClassPoolResource sizeClassPool;
+	mixedSizes("SizeClassPoolResource", ResourceAllocator{ &sizeClassPool }, sizes);
+}
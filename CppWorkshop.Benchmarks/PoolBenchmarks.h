@@ -0,0 +1,60 @@
+/*
+ * Helpers shared by the pool allocator benchmarks.
+ */
+#pragma once
+#include <mutex>
+#include "Benchmark.h"
+#include "Allocators/PoolAllocator.h"
+
+namespace Benchmark
+{
+	// A small object roughly the size of the Tank in the pool allocator example.
+	struct PoolItem
+	{
+		PoolItem(int x, int y, int z) : x(x), y(y), z(z) {}
+		int x, y, z;
+	};
+
+	// The simplest way to make the existing pool thread safe, used as the baseline when comparing
+	// the thread safe pools.
+	template<class type, size_t pool_size>
+	class LockedPoolAllocator
+	{
+	public:
+		template <class... _Types>
+		type* construct(_Types&&... _Args)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _pool.construct(std::forward<_Types>(_Args)...);
+		}
+
+		void destruct(type* pMem)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pool.destruct(pMem);
+		}
+
+	private:
+		std::mutex _mutex;
+		PoolAllocator<type, pool_size> _pool;
+	};
+
+	// Each thread repeatedly allocates a small batch of items and then releases them again, which
+	// is roughly what a request handler does. Reports one construct + destruct pair as an
+	// operation.
+	template<int batch_size, class Pool>
+	void churnPool(const char* name, Pool& pool, unsigned int threads, int iterations)
+	{
+		double seconds = runThreads(threads, [&pool, iterations](unsigned int t) {
+			PoolItem* batch[batch_size];
+			for (int i = 0; i < iterations; i++)
+			{
+				for (int j = 0; j < batch_size; j++)
+					batch[j] = pool.construct((int)t, i, j);
+				for (int j = 0; j < batch_size; j++)
+					pool.destruct(batch[j]);
+			}
+		});
+		report(name, threads, (size_t)threads * iterations * batch_size, seconds);
+	}
+}
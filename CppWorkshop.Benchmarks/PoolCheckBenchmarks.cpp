@@ -0,0 +1,34 @@
+/*
+ * Measures the cost of each PoolAllocator check policy, and of enabling telemetry, on the
+ * construct/destruct hot path.
+ */
+#include "PoolBenchmarks.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	const size_t POOL_SIZE = 1024;
+	const int BATCH_SIZE = 8;
+	const int ITERATIONS = 500000;
+
+	PoolAllocator<PoolItem, POOL_SIZE, 0, NoPoolChecks> s_noChecksPool;
+	PoolAllocator<PoolItem, POOL_SIZE, 0, RangePoolChecks> s_rangeChecksPool;
+	PoolAllocator<PoolItem, POOL_SIZE, 0, DefaultPoolChecks> s_defaultChecksPool;
+	PoolAllocator<PoolItem, POOL_SIZE, 0, FullPoolChecks> s_fullChecksPool;
+	PoolAllocator<PoolItem, POOL_SIZE, 0, DefaultPoolChecks, LifoFreeList, PoolTelemetry> s_telemetryPool;
+}
+
+BENCHMARK(Pool_Check_Policies)
+{
+	churnPool<BATCH_SIZE>("NoPoolChecks", s_noChecksPool, 1, ITERATIONS);
+	churnPool<BATCH_SIZE>("RangePoolChecks", s_rangeChecksPool, 1, ITERATIONS);
+	churnPool<BATCH_SIZE>("DefaultPoolChecks", s_defaultChecksPool, 1, ITERATIONS);
+	churnPool<BATCH_SIZE>("FullPoolChecks", s_fullChecksPool, 1, ITERATIONS);
+}
+
+BENCHMARK(Pool_Telemetry)
+{
+	churnPool<BATCH_SIZE>("NoPoolTelemetry", s_defaultChecksPool, 1, ITERATIONS);
+	churnPool<BATCH_SIZE>("PoolTelemetry", s_telemetryPool, 1, ITERATIONS);
+}
@@ -0,0 +1,58 @@
+/*
+ * Compares updating every live item in a partially filled pool via a separate list of pointers
+ * against walking the pool's occupancy bitmap with for_each_live.
+ */
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "PoolBenchmarks.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	// Large enough that the pool doesn't fit in the cache.
+	const size_t POOL_SIZE = 1000000;
+	const int PASSES = 20;
+
+	PoolAllocator<PoolItem, POOL_SIZE> s_pool;
+}
+
+BENCHMARK(Pool_For_Each_Live)
+{
+	// Fill the pool then release a random half of it, the way a pool looks after some churn.
+	std::vector<PoolItem*> items;
+	for (size_t i = 0; i < POOL_SIZE; i++)
+		items.push_back(s_pool.construct((int)i, 1, 2));
+	std::mt19937 random(1234);
+	std::shuffle(items.begin(), items.end(), random);
+	for (size_t i = POOL_SIZE / 2; i < POOL_SIZE; i++)
+		s_pool.destruct(items[i]);
+	items.resize(POOL_SIZE / 2);
+
+	long long total = 0;
+	auto start = Clock::now();
+	for (int pass = 0; pass < PASSES; pass++)
+	{
+		for (auto pItem : items)
+		{
+			pItem->x++;
+			total += pItem->y;
+		}
+	}
+	report("Pointer list", 1, items.size() * PASSES, secondsSince(start));
+
+	start = Clock::now();
+	for (int pass = 0; pass < PASSES; pass++)
+	{
+		s_pool.for_each_live([&total](PoolItem& item) {
+			item.x++;
+			total += item.y;
+		});
+	}
+	report("PoolAllocator::for_each_live", 1, items.size() * PASSES, secondsSince(start));
+	doNotOptimise(total);
+
+	for (auto pItem : items)
+		s_pool.destruct(pItem);
+}
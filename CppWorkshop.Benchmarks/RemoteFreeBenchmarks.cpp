@@ -0,0 +1,80 @@
+/*
+ * A producer thread constructs items and hands them to a consumer thread through a queue, and the
+ * consumer releases them. Compares sharing a locked PoolAllocator between the two threads against
+ * a PoolAllocator using the RemoteFrees policy, where the consumer never touches the producer's
+ * free list.
+ */
+#include <atomic>
+#include <thread>
+#include "PoolBenchmarks.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	const size_t QUEUE_SIZE = 1024;
+	// Room for a full queue plus the item the consumer is working on.
+	const size_t POOL_SIZE = QUEUE_SIZE + 2;
+	const int ITEMS = 4000000;
+
+	// A minimal single producer, single consumer ring buffer.
+	class ItemQueue
+	{
+	public:
+		ItemQueue() : _head(0), _tail(0) {}
+
+		void push(PoolItem* pItem)
+		{
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			while (tail - _head.load(std::memory_order_acquire) == QUEUE_SIZE) std::this_thread::yield();
+			_items[tail % QUEUE_SIZE] = pItem;
+			_tail.store(tail + 1, std::memory_order_release);
+		}
+
+		PoolItem* pop()
+		{
+			size_t head = _head.load(std::memory_order_relaxed);
+			while (_tail.load(std::memory_order_acquire) == head) std::this_thread::yield();
+			PoolItem* pItem = _items[head % QUEUE_SIZE];
+			_head.store(head + 1, std::memory_order_release);
+			return pItem;
+		}
+
+	private:
+		alignas(64) std::atomic<size_t> _head;
+		alignas(64) std::atomic<size_t> _tail;
+		alignas(64) PoolItem* _items[QUEUE_SIZE];
+	};
+
+	template<class Pool, class DestructFunc>
+	void producerConsumer(const char* name, Pool& pool, DestructFunc destruct)
+	{
+		ItemQueue queue;
+		double seconds = runThreads(2, [&pool, &queue, &destruct](unsigned int t) {
+			if (t == 0)
+			{
+				for (int i = 0; i < ITEMS; i++)
+					queue.push(pool.construct(i, 1, 2));
+			}
+			else
+			{
+				for (int i = 0; i < ITEMS; i++)
+					destruct(pool, queue.pop());
+			}
+		});
+		report(name, 2, ITEMS, seconds);
+	}
+
+	LockedPoolAllocator<PoolItem, POOL_SIZE> s_lockedPool;
+	PoolAllocator<PoolItem, POOL_SIZE, 0, DefaultPoolChecks, LifoFreeList, NoPoolTelemetry, RemoteFrees> s_remoteFreePool;
+}
+
+BENCHMARK(Pool_Remote_Frees)
+{
+	producerConsumer("PoolAllocator + std::mutex", s_lockedPool, [](LockedPoolAllocator<PoolItem, POOL_SIZE>& pool, PoolItem* pItem) {
+		pool.destruct(pItem);
+	});
+	producerConsumer("PoolAllocator + RemoteFrees", s_remoteFreePool, [](decltype(s_remoteFreePool)& pool, PoolItem* pItem) {
+		pool.destruct_remote(pItem);
+	});
+}
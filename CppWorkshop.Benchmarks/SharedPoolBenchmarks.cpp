@@ -0,0 +1,57 @@
+/*
+ * Compares creating and releasing shared_ptrs via std::make_shared, PoolAllocator::make_shared,
+ * which still allocates its control block from the heap, and SharedPoolAllocator::make_shared,
+ * which keeps the control block in the pool slot alongside the item.
+ */
+#include <memory>
+#include "PoolBenchmarks.h"
+#include "Allocators/SharedPoolAllocator.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	const size_t POOL_SIZE = 1024;
+	const int BATCH_SIZE = 64;
+	const int ITERATIONS = 100000;
+
+	PoolAllocator<PoolItem, POOL_SIZE> s_pool;
+	SharedPoolAllocator<PoolItem, POOL_SIZE> s_sharedPool;
+
+	// Creates a batch of shared items, takes a copy of each one (touching the reference counts as
+	// a container of shared_ptrs would) and then releases them all again.
+	template<class MakeFunc>
+	void churnShared(const char* name, MakeFunc make)
+	{
+		std::shared_ptr<PoolItem> items[BATCH_SIZE];
+		long long total = 0;
+		auto start = Clock::now();
+		for (int i = 0; i < ITERATIONS; i++)
+		{
+			for (int j = 0; j < BATCH_SIZE; j++)
+				items[j] = make(i, j);
+			for (int j = 0; j < BATCH_SIZE; j++)
+			{
+				auto copy = items[j];
+				total += copy->y;
+			}
+			for (int j = 0; j < BATCH_SIZE; j++)
+				items[j].reset();
+		}
+		doNotOptimise(total);
+		report(name, 1, (size_t)ITERATIONS * BATCH_SIZE, secondsSince(start));
+	}
+}
+
+BENCHMARK(Shared_Pool)
+{
+	churnShared("std::make_shared", [](int i, int j) {
+		return std::make_shared<PoolItem>(i, j, 0);
+	});
+	churnShared("PoolAllocator::make_shared", [](int i, int j) {
+		return s_pool.make_shared(i, j, 0);
+	});
+	churnShared("SharedPoolAllocator::make_shared", [](int i, int j) {
+		return s_sharedPool.make_shared(i, j, 0);
+	});
+}
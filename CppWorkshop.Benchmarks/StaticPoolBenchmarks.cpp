@@ -0,0 +1,50 @@
+/*
+ * Compares a container of PoolAllocator::unique_ptrs, which each carry a pointer to their pool,
+ * against one of statically bound unique_ptrs that are the size of a raw pointer.
+ */
+#include <vector>
+#include "PoolBenchmarks.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	const size_t POOL_SIZE = 1000000;
+	const int PASSES = 20;
+
+	typedef PoolAllocator<PoolItem, POOL_SIZE> ItemPool;
+	ItemPool s_pool;
+
+	template<class Pointer, class MakeFunc>
+	void iterateContainer(const char* name, MakeFunc make)
+	{
+		std::vector<Pointer> items;
+		items.reserve(POOL_SIZE);
+		for (size_t i = 0; i < POOL_SIZE; i++)
+			items.push_back(make((int)i));
+		reportMemory(name, items.capacity() * sizeof(Pointer), items.size());
+
+		long long total = 0;
+		auto start = Clock::now();
+		for (int pass = 0; pass < PASSES; pass++)
+		{
+			for (auto& pItem : items)
+			{
+				pItem->x++;
+				total += pItem->y;
+			}
+		}
+		doNotOptimise(total);
+		report(name, 1, POOL_SIZE * PASSES, secondsSince(start));
+	}
+}
+
+BENCHMARK(Pool_Static_Unique_Ptr)
+{
+	iterateContainer<ItemPool::unique_ptr>("unique_ptr", [](int i) {
+		return s_pool.make_unique(i, 1, 2);
+	});
+	iterateContainer<ItemPool::static_unique_ptr<s_pool>>("static_unique_ptr", [](int i) {
+		return ItemPool::make_static_unique<s_pool>(i, 1, 2);
+	});
+}
@@ -0,0 +1,88 @@
+/*
+ * Insert/erase heavy workloads on node based containers, comparing the default std::allocator
+ * against PoolStlAllocator.
+ */
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "PoolBenchmarks.h"
+#include "Allocators/PoolStlAllocator.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	const int ITEMS = 10000;
+	const int ROUNDS = 100;
+	// Room for every item plus anything the container allocates alongside them.
+	const size_t POOL_SIZE = ITEMS + 16;
+
+	typedef std::pair<const int, int> MapValue;
+
+	// Keys in a random order so the trees and hash tables get a realistic mix of inserts.
+	std::vector<int> randomKeys()
+	{
+		std::vector<int> keys;
+		for (int i = 0; i < ITEMS; i++)
+			keys.push_back(i);
+		std::mt19937 random(1234);
+		std::shuffle(keys.begin(), keys.end(), random);
+		return keys;
+	}
+
+	// Fills the list and then empties it from the front, so nodes are released in a different
+	// order to the one they were allocated in.
+	template<class Allocator>
+	void listChurn(const char* name)
+	{
+		std::list<int, Allocator> items;
+		auto start = Clock::now();
+		for (int round = 0; round < ROUNDS; round++)
+		{
+			for (int i = 0; i < ITEMS; i++)
+				items.push_back(i);
+			while (!items.empty())
+				items.pop_front();
+		}
+		report(name, 1, (size_t)ITEMS * ROUNDS, secondsSince(start));
+	}
+
+	template<class Map>
+	void mapChurn(const char* name, const std::vector<int>& keys)
+	{
+		Map items;
+		auto start = Clock::now();
+		for (int round = 0; round < ROUNDS; round++)
+		{
+			for (int key : keys)
+				items.emplace(key, round);
+			for (int i = ITEMS - 1; i >= 0; i--)
+				items.erase(keys[i]);
+		}
+		report(name, 1, (size_t)ITEMS * ROUNDS, secondsSince(start));
+	}
+}
+
+BENCHMARK(Stl_List_Insert_Erase)
+{
+	listChurn<std::allocator<int>>("std::list + std::allocator");
+	listChurn<PoolStlAllocator<int, POOL_SIZE>>("std::list + PoolStlAllocator");
+}
+
+BENCHMARK(Stl_Map_Insert_Erase)
+{
+	auto keys = randomKeys();
+	mapChurn<std::map<int, int>>("std::map + std::allocator", keys);
+	mapChurn<std::map<int, int, std::less<int>, PoolStlAllocator<MapValue, POOL_SIZE>>>("std::map + PoolStlAllocator", keys);
+}
+
+BENCHMARK(Stl_Unordered_Map_Insert_Erase)
+{
+	auto keys = randomKeys();
+	mapChurn<std::unordered_map<int, int>>("std::unordered_map + std::allocator", keys);
+	mapChurn<std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, PoolStlAllocator<MapValue, POOL_SIZE>>>("std::unordered_map + PoolStlAllocator", keys);
+}
@@ -0,0 +1,163 @@
+/*
+ * The cost of counting allocations when a TrackingAllocator is shared between threads, comparing
+ * a single pair of atomic counters against ShardedTrackingCounters. Also compares the memory used
+ * and the speed of tracking with a size header against asking the heap for the size, and the cost
+ * of heap sampling.
+ */
+#include <atomic>
+#include <malloc.h>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "Allocators/HeapSampler.h"
+#include "Allocators/TrackingAllocator.h"
+
+using namespace Benchmark;
+
+namespace
+{
+	const int ITERATIONS = 1000000;
+
+	// The obvious way to make the counts thread safe. Correct, but every thread writes to the same
+	// cache line.
+	class AtomicTrackingCounters
+	{
+	public:
+		AtomicTrackingCounters() : _numAllocations(0), _totalAllocationsSize(0) {}
+
+		unsigned int getNumAllocations() const { return _numAllocations.load(std::memory_order_relaxed); }
+		size_t getTotalAllocationsSize() const { return _totalAllocationsSize.load(std::memory_order_relaxed); }
+
+	protected:
+		void onAllocate(size_t size)
+		{
+			_numAllocations.fetch_add(1, std::memory_order_relaxed);
+			_totalAllocationsSize.fetch_add(size, std::memory_order_relaxed);
+		}
+
+		void onDeallocate(size_t size)
+		{
+			_totalAllocationsSize.fetch_sub(size, std::memory_order_relaxed);
+			_numAllocations.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<unsigned int> _numAllocations;
+		std::atomic<size_t> _totalAllocationsSize;
+	};
+
+	// Allocates and then releases a batch of items, reporting one allocate + deallocate pair as an
+	// operation.
+	template<class Allocator, class Item>
+	void churn(const std::string& name, std::vector<Item*>& items)
+	{
+		const int ROUNDS = 20;
+		Allocator allocator;
+		auto start = Clock::now();
+		for (int round = 0; round < ROUNDS; round++)
+		{
+			for (size_t i = 0; i < items.size(); i++)
+				items[i] = allocator.allocate(1);
+			for (size_t i = 0; i < items.size(); i++)
+				allocator.deallocate(items[i]);
+		}
+		report(name, 1, items.size() * ROUNDS, secondsSince(start));
+	}
+
+	template<size_t size>
+	struct Object
+	{
+		char data[size];
+	};
+
+	// What the heap really set aside for a block, including its own rounding up.
+	size_t getHeapBlockSize(void* pBlock)
+	{
+#ifdef _WIN32
+		return _msize(pBlock);
+#else
+		return malloc_usable_size(pBlock);
+#endif
+	}
+
+	// Allocates a lot of objects one at a time, as new would for a class like TrackedVector2, and
+	// reports how much heap memory they take up with and without the header, followed by the time
+	// taken to allocate and release them.
+	template<size_t size>
+	void compareModes()
+	{
+		const size_t ITEMS = 100000;
+		typedef TrackingAllocator<Object<size>> HeaderAllocator;
+		typedef TrackingAllocator<Object<size>, 0, TrackingCounters, TrackingMode::USABLE_SIZE> HeaderlessAllocator;
+		std::string suffix = " " + std::to_string(size) + "B";
+
+		HeaderAllocator withHeader;
+		HeaderlessAllocator withoutHeader;
+		std::vector<Object<size>*> items(ITEMS);
+		size_t headerBytes = 0;
+		size_t headerlessBytes = 0;
+		for (size_t i = 0; i < ITEMS; i++)
+		{
+			items[i] = withHeader.allocate(1);
+			headerBytes += getHeapBlockSize(reinterpret_cast<uint8_t*>(items[i]) - HeaderAllocator::HEADER_SIZE);
+		}
+		for (size_t i = 0; i < ITEMS; i++)
+			withHeader.deallocate(items[i]);
+		for (size_t i = 0; i < ITEMS; i++)
+		{
+			items[i] = withoutHeader.allocate(1);
+			headerlessBytes += getHeapBlockSize(items[i]);
+		}
+		for (size_t i = 0; i < ITEMS; i++)
+			withoutHeader.deallocate(items[i]);
+		reportMemory("Size header" + suffix, headerBytes, ITEMS);
+		reportMemory("Usable size" + suffix, headerlessBytes, ITEMS);
+
+		churn<HeaderAllocator>("Size header" + suffix, items);
+		churn<HeaderlessAllocator>("Usable size" + suffix, items);
+	}
+
+	// Reports one allocate + deallocate pair as an operation.
+	template<class Allocator>
+	void churnShared(const std::string& name, unsigned int threads)
+	{
+		Allocator allocator;
+		double seconds = runThreads(threads, [&allocator](unsigned int) {
+			for (int i = 0; i < ITERATIONS; i++)
+			{
+				uint64_t* pItem = allocator.allocate(2);
+				doNotOptimise(pItem);
+				allocator.deallocate(pItem);
+			}
+		});
+		report(name, threads, (size_t)threads * ITERATIONS, seconds);
+	}
+}
+
+BENCHMARK(Tracking_Shared_Counters)
+{
+	for (unsigned int threads : { 1u, 2u, 4u, 8u })
+	{
+		churnShared<TrackingAllocator<uint64_t, 0, AtomicTrackingCounters>>("TrackingAllocator + atomic counters", threads);
+		churnShared<TrackingAllocator<uint64_t, 0, ShardedTrackingCounters>>("TrackingAllocator + sharded counters", threads);
+	}
+}
+
+BENCHMARK(Tracking_Usable_Size)
+{
+	compareModes<8>();
+	compareModes<24>();
+	compareModes<40>();
+	compareModes<56>();
+	compareModes<120>();
+}
+
+BENCHMARK(Tracking_Heap_Sampling)
+{
+	std::vector<Object<64>*> items(100000);
+	churn<TrackingAllocator<Object<64>>>("No sampling", items);
+	churn<TrackingAllocator<Object<64>, 0, TrackingCounters, TrackingMode::SIZE_HEADER, HeapSampler>>("HeapSampler, default period", items);
+	HeapSampler::setSamplePeriod(64 * 1024);
+	churn<TrackingAllocator<Object<64>, 0, TrackingCounters, TrackingMode::SIZE_HEADER, HeapSampler>>("HeapSampler, 64KB period", items);
+	HeapSampler::setSamplePeriod(HeapSampler::DEFAULT_SAMPLE_PERIOD);
+}
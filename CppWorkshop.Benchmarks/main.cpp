@@ -0,0 +1,153 @@
+/*
+ * Entry point for the benchmarks. Runs every registered benchmark, or only those whose name
+ * contains one of the strings passed on the command line. --json <file> also writes the results to
+ * the file. When built with TRACK_GLOBAL_NEW, each benchmark also reports how much it allocated
+ * with new.
+ */
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+#include <string.h>
+#include "Benchmark.h"
+#include "Allocators/TrackedGlobalNew.h"
+
+namespace Benchmark
+{
+	const void* volatile g_sink = nullptr;
+
+	// Set when --json is passed on the command line.
+	static FILE* s_pJsonFile = nullptr;
+	static bool s_firstJsonResult = true;
+	// The benchmark currently being run, so results can be grouped by it in the JSON output.
+	static const char* s_pCurrentBenchmark = "";
+
+	std::vector<Registration>& registry()
+	{
+		// Function local static so that registration order between translation units doesn't
+		// matter.
+		static std::vector<Registration> s_registry;
+		return s_registry;
+	}
+
+	static void writeJsonString(const char* value)
+	{
+		fputc('"', s_pJsonFile);
+		for (; *value != '\0'; value++)
+		{
+			if (*value == '"' || *value == '\\') fputc('\\', s_pJsonFile);
+			fputc(*value, s_pJsonFile);
+		}
+		fputc('"', s_pJsonFile);
+	}
+
+	// JSON has no way to write infinity or NaN, which a rate gets when the time taken rounds down to
+	// zero, so they're written as null instead.
+	static std::string jsonNumber(const char* format, double value)
+	{
+		if (!std::isfinite(value)) return "null";
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), format, value);
+		return buffer;
+	}
+
+	// Writes one result object to the JSON output. fields holds the rest of the object's members,
+	// already formatted.
+	static void writeJsonResult(const std::string& name, const char* fields)
+	{
+		if (s_pJsonFile == nullptr) return;
+		fputs(s_firstJsonResult ? "\n    { \"benchmark\": " : ",\n    { \"benchmark\": ", s_pJsonFile);
+		writeJsonString(s_pCurrentBenchmark);
+		fputs(", \"name\": ", s_pJsonFile);
+		writeJsonString(name.c_str());
+		fprintf(s_pJsonFile, ", %s }", fields);
+		s_firstJsonResult = false;
+	}
+
+	void report(const std::string& name, unsigned int threads, size_t operations, double seconds)
+	{
+		printf("%-48s threads=%-3u ops=%-10zu time=%8.3fms  %8.2f Mops/s\n",
+			name.c_str(), threads, operations, seconds * 1000.0, (operations / seconds) / 1000000.0);
+
+		char fields[256];
+		snprintf(fields, sizeof(fields), "\"threads\": %u, \"operations\": %zu, \"seconds\": %.9f, \"ops_per_second\": %s",
+			threads, operations, seconds, jsonNumber("%.1f", operations / seconds).c_str());
+		writeJsonResult(name, fields);
+	}
+
+	void reportLatency(const std::string& name, unsigned int threads, size_t operations, double seconds, std::vector<double> latencies)
+	{
+		// Nearest rank percentiles.
+		std::sort(latencies.begin(), latencies.end());
+		double median = latencies.empty() ? 0.0 : latencies[latencies.size() / 2];
+		double p99 = latencies.empty() ? 0.0 : latencies[(latencies.size() * 99 + 99) / 100 - 1];
+
+		printf("%-48s threads=%-3u ops=%-10zu time=%8.3fms  %8.2f Mops/s  median=%7.1fns  p99=%7.1fns\n",
+			name.c_str(), threads, operations, seconds * 1000.0, (operations / seconds) / 1000000.0, median, p99);
+
+		char fields[256];
+		snprintf(fields, sizeof(fields), "\"threads\": %u, \"operations\": %zu, \"seconds\": %.9f, \"ops_per_second\": %s, \"median_ns\": %.2f, \"p99_ns\": %.2f",
+			threads, operations, seconds, jsonNumber("%.1f", operations / seconds).c_str(), median, p99);
+		writeJsonResult(name, fields);
+	}
+
+	void reportMemory(const std::string& name, size_t bytes, size_t items)
+	{
+		printf("%-48s items=%-10zu bytes=%-12zu %8.2f bytes/item\n",
+			name.c_str(), items, bytes, (double)bytes / items);
+
+		char fields[128];
+		snprintf(fields, sizeof(fields), "\"items\": %zu, \"bytes\": %zu", items, bytes);
+		writeJsonResult(name, fields);
+	}
+}
+
+static bool isSelected(const char* name, const std::vector<const char*>& filters)
+{
+	if (filters.empty()) return true;
+	for (const char* filter : filters)
+		if (strstr(name, filter) != nullptr) return true;
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<const char*> filters;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--json") != 0)
+		{
+			filters.push_back(argv[i]);
+			continue;
+		}
+		if (++i == argc)
+		{
+			fprintf(stderr, "--json needs a file name\n");
+			return 1;
+		}
+		Benchmark::s_pJsonFile = fopen(argv[i], "w");
+		if (Benchmark::s_pJsonFile == nullptr)
+		{
+			fprintf(stderr, "Unable to open %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (Benchmark::s_pJsonFile != nullptr) fputs("{\n  \"results\": [", Benchmark::s_pJsonFile);
+	for (auto& benchmark : Benchmark::registry())
+	{
+		if (!isSelected(benchmark.name, filters)) continue;
+		printf("== %s\n", benchmark.name);
+		Benchmark::s_pCurrentBenchmark = benchmark.name;
+		auto before = GlobalTrackingCounters::getCounts();
+		benchmark.func();
+		auto after = GlobalTrackingCounters::getCounts();
+		if (GlobalTrackingCounters::TRACKS_GLOBAL_NEW && after.totalAllocations != before.totalAllocations)
+			Benchmark::reportMemory("operator new (whole benchmark)", after.totalBytes - before.totalBytes, after.totalAllocations - before.totalAllocations);
+	}
+	if (Benchmark::s_pJsonFile != nullptr)
+	{
+		fputs("\n  ]\n}\n", Benchmark::s_pJsonFile);
+		fclose(Benchmark::s_pJsonFile);
+	}
+	return 0;
+}
@@ -0,0 +1,28 @@
+/*
+ * Portable wrappers around the bit scanning instructions used by the allocators. These compile
+ * down to a single tzcnt/bsf (x86) or rbit+clz (ARM) instruction.
+ */
+#pragma once
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Returns the index of the lowest set bit. The result is undefined if value is 0.
+inline unsigned int countTrailingZeros(uint64_t value)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return (unsigned int)index;
+#elif defined(_MSC_VER)
+	// 32 bit builds don't have a 64 bit scan so we check each half in turn.
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)value)) return (unsigned int)index;
+	_BitScanForward(&index, (unsigned long)(value >> 32));
+	return (unsigned int)index + 32;
+#else
+	return (unsigned int)__builtin_ctzll(value);
+#endif
+}
@@ -0,0 +1,188 @@
+/*
+ * A thread safe version of the PoolAllocator that can be shared between multiple threads without
+ * needing to be wrapped in a mutex.
+ * The free list is implemented as a lock-free stack (a Treiber stack). Pushing and popping are
+ * performed using a compare-and-swap on the head of the list and so threads never block each
+ * other, they just retry if another thread got in first.
+ *
+ * The classic problem with lock-free stacks is ABA. Thread 1 reads head A and its next pointer B,
+ * but before it can swap A for B, thread 2 pops A, pops B and pushes A back again. The head is A
+ * again so thread 1's compare-and-swap succeeds, but B is no longer free and we've just corrupted
+ * the list. To guard against this, the head is "tagged" with a counter that is incremented on
+ * every change so that the compare-and-swap fails if anything has happened in between.
+ */
+#pragma once
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stddef.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <utility>
+
+template<class type, size_t pool_size>
+class ConcurrentPoolAllocator
+{
+	// Slots are referenced by 32 bit index rather than pointer so that the index and tag can be
+	// packed into a single 64 bit value. A 64 bit compare-and-swap is lock-free on every platform
+	// we care about, whereas a 128 bit pointer + tag swap isn't always available.
+	static_assert(pool_size < 0xFFFFFFFE, "Pool too large to be indexed with 32 bits");
+
+public:
+	typedef ConcurrentPoolAllocator<type, pool_size> pool_type;
+
+	// Same as PoolAllocator::Deletor, routes delete requests from smart pointers back to the pool.
+	class Deletor final
+	{
+	public:
+		Deletor(pool_type* pPool) noexcept:
+			_pPool(pPool) {}
+
+		Deletor(const Deletor& other) noexcept:
+			_pPool(other._pPool) {}
+
+		Deletor(Deletor&& other) noexcept :
+			_pPool(std::exchange(other._pPool, nullptr)) {}
+
+		void operator()(type* pMem)
+		{
+			_pPool->destruct(pMem);
+		}
+
+	private:
+		pool_type* _pPool;
+	};
+
+	typedef std::unique_ptr<type, Deletor> unique_ptr;
+
+	ConcurrentPoolAllocator()
+	{
+		reset();
+	}
+
+	// Unlike construct/destruct, reset is NOT thread safe. It should only be called when no other
+	// threads are using the pool.
+	void reset()
+	{
+		// Link every slot to the one after it so that allocations are handed out in address order
+		// from a fresh pool.
+		for (size_t i = 0; i < pool_size; i++)
+			_pool[i].next.store((uint32_t)(i + 1), std::memory_order_relaxed);
+		if (pool_size != 0)
+			_pool[pool_size - 1].next.store(END_OF_LIST, std::memory_order_relaxed);
+
+		_allocation_count.store(0, std::memory_order_relaxed);
+		_head.store(pack(pool_size != 0 ? 0 : END_OF_LIST, 0), std::memory_order_release);
+	}
+
+	size_t getPoolSize() const { return pool_size; }
+	// The counts are only a snapshot, other threads may have changed them by the time you look.
+	unsigned int getFreeCount() const { return (unsigned int)(pool_size - _allocation_count.load(std::memory_order_relaxed)); }
+	unsigned int getAllocCount() const { return (unsigned int)_allocation_count.load(std::memory_order_relaxed); }
+
+	template <class... _Types>
+	type* construct(_Types&&... _Args)
+	{
+		// An empty free list is our capacity check. Checking the count first and then popping
+		// would be racy as another thread could take the last slot in between.
+		uint32_t index = pop();
+		if (index == END_OF_LIST) throw std::bad_alloc();
+		_allocation_count.fetch_add(1, std::memory_order_relaxed);
+
+		PoolEntry& entry = _pool[index];
+		entry.next.store(ENTRY_IN_USE, std::memory_order_relaxed);
+		return new(entry.mem) type(std::forward<_Types>(_Args)...);
+	}
+
+	void destruct(type* pMem)
+	{
+		uint32_t index = getIndex(pMem);
+		pMem->~type();
+		_allocation_count.fetch_sub(1, std::memory_order_relaxed);
+		push(index);
+	}
+
+	template <class... _Types>
+	std::shared_ptr<type> make_shared(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return std::shared_ptr<type>(pItem, Deletor(this));
+	}
+
+	template <class... _Types>
+	unique_ptr make_unique(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return unique_ptr(pItem, Deletor(this));
+	}
+
+private:
+	static constexpr uint32_t END_OF_LIST = 0xFFFFFFFF;
+	// Marker value for the next index of slots that are currently allocated.
+	static constexpr uint32_t ENTRY_IN_USE = 0xFFFFFFFE;
+
+	struct PoolEntry
+	{
+		// The next link needs to be atomic as a thread attempting to pop this entry may read it at
+		// the same time as the thread that won the race overwrites it with ENTRY_IN_USE. The read
+		// value is discarded in that case as the tagged compare-and-swap will fail.
+		std::atomic<uint32_t> next;
+		alignas(type) char mem[sizeof(type)];
+	};
+
+	static uint64_t pack(uint32_t index, uint32_t tag) { return ((uint64_t)tag << 32) | index; }
+	static uint32_t indexOf(uint64_t head) { return (uint32_t)head; }
+	static uint32_t tagOf(uint64_t head) { return (uint32_t)(head >> 32); }
+
+	uint32_t pop()
+	{
+		uint64_t head = _head.load(std::memory_order_acquire);
+		for (;;)
+		{
+			uint32_t index = indexOf(head);
+			if (index == END_OF_LIST) return END_OF_LIST;
+			uint32_t next = _pool[index].next.load(std::memory_order_relaxed);
+			// On failure, head is updated with the current value and we go round again.
+			if (_head.compare_exchange_weak(head, pack(next, tagOf(head) + 1), std::memory_order_acquire, std::memory_order_acquire))
+				return index;
+		}
+	}
+
+	void push(uint32_t index)
+	{
+		uint64_t head = _head.load(std::memory_order_relaxed);
+		do
+		{
+			_pool[index].next.store(indexOf(head), std::memory_order_relaxed);
+		}
+		// Release ordering publishes both the next link and the destruction of the old object to
+		// whichever thread pops this slot next.
+		while (!_head.compare_exchange_weak(head, pack(index, tagOf(head) + 1), std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	uint32_t getIndex(type* pMem)
+	{
+		// Same verification as PoolAllocator, the address must be within the pool, must point at
+		// the start of an item and the slot must currently be allocated.
+		auto raw = reinterpret_cast<char*>(pMem);
+		auto base = reinterpret_cast<char*>(_pool);
+		if (raw < base || raw >= base + sizeof(_pool)) throw std::invalid_argument("Allocation is not within this pool");
+		size_t offset = raw - base;
+		if (offset % sizeof(PoolEntry) != offsetof(PoolEntry, mem)) throw std::invalid_argument("Allocation is not within this pool");
+		uint32_t index = (uint32_t)(offset / sizeof(PoolEntry));
+		if (_pool[index].next.load(std::memory_order_relaxed) != ENTRY_IN_USE) throw std::invalid_argument("Allocation already appears to have been destructed");
+		return index;
+	}
+
+	// The head and the count are hammered by every thread, so they are kept on their own cache
+	// lines to avoid false sharing with each other and with the first few pool entries.
+	alignas(64) std::atomic<uint64_t> _head;
+	alignas(64) std::atomic<size_t> _allocation_count;
+	alignas(64) PoolEntry _pool[pool_size];
+};
+
+template<class type, size_t pool_size>
+constexpr uint32_t ConcurrentPoolAllocator<type, pool_size>::END_OF_LIST;
+
+template<class type, size_t pool_size>
+constexpr uint32_t ConcurrentPoolAllocator<type, pool_size>::ENTRY_IN_USE;
@@ -0,0 +1,150 @@
+/*
+ * A version of the PoolAllocator that stores the items densely, separate from the free list.
+ *
+ * PoolAllocator puts a next pointer in front of every item. For small types that overhead is
+ * significant, e.g. a 12 byte item takes up a 24 byte slot on a 64 bit build once padding is taken
+ * into account, and so only half as many live items fit in each cache line when iterating over
+ * them.
+ * This pool keeps the items in an array of their own and keeps the free list links in a separate
+ * array of indexes instead. The indexes are only as wide as they need to be for the pool size, so
+ * a pool of fewer than 65534 items only needs 2 bytes of book keeping per item.
+ */
+#pragma once
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+// Picks the smallest unsigned type able to index every slot in the pool, leaving room for the two
+// marker values.
+template<size_t pool_size>
+using DensePoolIndex = typename std::conditional<(pool_size < 0xFE), uint8_t,
+	typename std::conditional<(pool_size < 0xFFFE), uint16_t, uint32_t>::type>::type;
+
+template<class type, size_t pool_size, class index_type = DensePoolIndex<pool_size>>
+class DensePoolAllocator
+{
+	static_assert(std::is_unsigned<index_type>::value, "index_type must be an unsigned integer type");
+	static_assert(pool_size < (size_t)(index_type)-2, "index_type is too small for this pool size");
+
+public:
+	typedef DensePoolAllocator<type, pool_size, index_type> pool_type;
+
+	// Same as PoolAllocator::Deletor, routes delete requests from smart pointers back to the pool.
+	class Deletor final
+	{
+	public:
+		Deletor(pool_type* pPool) noexcept:
+			_pPool(pPool) {}
+
+		Deletor(const Deletor& other) noexcept:
+			_pPool(other._pPool) {}
+
+		Deletor(Deletor&& other) noexcept :
+			_pPool(std::exchange(other._pPool, nullptr)) {}
+
+		void operator()(type* pMem)
+		{
+			_pPool->destruct(pMem);
+		}
+
+	private:
+		pool_type* _pPool;
+	};
+
+	typedef std::unique_ptr<type, Deletor> unique_ptr;
+
+	DensePoolAllocator()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		// Link the slots in address order so that a fresh pool hands out items in the order they
+		// are laid out in memory.
+		_allocation_count = 0;
+		_next_free = pool_size != 0 ? 0 : END_OF_LIST;
+		for (size_t i = 0; i < pool_size; i++)
+			_next[i] = (index_type)(i + 1 < pool_size ? i + 1 : END_OF_LIST);
+	}
+
+	size_t getPoolSize() const { return pool_size; }
+	unsigned int getFreeCount() const { return (unsigned int)(pool_size - _allocation_count); }
+	unsigned int getAllocCount() const { return (unsigned int)_allocation_count; }
+
+	template <class... _Types>
+	type* construct(_Types&&... _Args)
+	{
+		if (_allocation_count == pool_size) throw std::bad_alloc();
+		_allocation_count++;
+		index_type index = _next_free;
+		_next_free = _next[index];
+		_next[index] = ENTRY_IN_USE;
+		return new(&_items[index]) type(std::forward<_Types>(_Args)...);
+	}
+
+	void destruct(type* pMem)
+	{
+		index_type index = getIndex(pMem);
+		pMem->~type();
+		_next[index] = _next_free;
+		_next_free = index;
+		_allocation_count--;
+	}
+
+	template <class... _Types>
+	std::shared_ptr<type> make_shared(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return std::shared_ptr<type>(pItem, Deletor(this));
+	}
+
+	template <class... _Types>
+	unique_ptr make_unique(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return unique_ptr(pItem, Deletor(this));
+	}
+
+private:
+	// Marker values that can't be valid slot indexes.
+	static constexpr index_type END_OF_LIST = (index_type)-2;
+	static constexpr index_type ENTRY_IN_USE = (index_type)-1;
+
+	// Storage for a single item. As with PoolAllocator, we don't store the items as type directly
+	// as there may not be a safe default constructor.
+	struct ItemStorage
+	{
+		alignas(type) char mem[sizeof(type)];
+	};
+
+	index_type getIndex(type* pMem)
+	{
+		// Check the address is within the item array and lands on the start of an item, and then
+		// that the slot is actually in use.
+		auto raw = reinterpret_cast<char*>(pMem);
+		auto base = reinterpret_cast<char*>(_items);
+		if (raw < base || raw >= base + sizeof(_items)) throw std::invalid_argument("Allocation is not within this pool");
+		size_t offset = raw - base;
+		if (offset % sizeof(ItemStorage) != 0) throw std::invalid_argument("Allocation is not within this pool");
+		auto index = (index_type)(offset / sizeof(ItemStorage));
+		if (_next[index] != ENTRY_IN_USE) throw std::invalid_argument("Allocation already appears to have been destructed");
+		return index;
+	}
+
+	// The items are packed together with nothing in between so iterating over them touches as few
+	// cache lines as possible. The free list links are off to one side.
+	ItemStorage _items[pool_size];
+	index_type _next[pool_size];
+	size_t _allocation_count;
+	index_type _next_free;
+};
+
+template<class type, size_t pool_size, class index_type>
+constexpr index_type DensePoolAllocator<type, pool_size, index_type>::END_OF_LIST;
+
+template<class type, size_t pool_size, class index_type>
+constexpr index_type DensePoolAllocator<type, pool_size, index_type>::ENTRY_IN_USE;
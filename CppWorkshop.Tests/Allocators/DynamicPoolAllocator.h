@@ -0,0 +1,270 @@
+/*
+ * A version of the PoolAllocator where the capacity is chosen at runtime instead of compile time.
+ *
+ * PoolAllocator stores its slots inline, which is great for small pools but a large pool declared
+ * as a local variable can overflow the stack, and a static one bloats the executable's data
+ * segment. This pool instead maps a single region of memory directly from the OS for its slots.
+ * That also lets us ask for the pages to be faulted in up front and for huge pages to be used, see
+ * VirtualMemory::Flags.
+ *
+ * Slots are handed out lazily, see PoolAllocator::reset. Creating or resetting the pool is O(1)
+ * and pages of the mapping that have never been used are never faulted in, so a generously sized
+ * pool only costs physical memory for the part of it that is actually used.
+ *
+ * Long lived pools with a lot of churn tend to end up with their live items scattered thinly across
+ * the whole of the used region, which is bad for cache and TLB locality and keeps every page
+ * resident. compact moves live items from the end of the pool into free slots nearer the front and
+ * hands the pages past the last live item back to the OS. Moving an item changes its address, so
+ * anything holding a pointer to it needs updating from the relocation callback. It can be given a
+ * time budget so that it can be run a little at a time, e.g. once per frame.
+ */
+#pragma once
+#include <chrono>
+#include <memory>
+#include <new>
+#include <stddef.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include "VirtualMemory.h"
+
+template<class type>
+class DynamicPoolAllocator
+{
+public:
+	typedef DynamicPoolAllocator<type> pool_type;
+
+	// Same as PoolAllocator::Deletor, routes delete requests from smart pointers back to the pool.
+	class Deletor final
+	{
+	public:
+		Deletor(pool_type* pPool) noexcept:
+			_pPool(pPool) {}
+
+		Deletor(const Deletor& other) noexcept:
+			_pPool(other._pPool) {}
+
+		Deletor(Deletor&& other) noexcept :
+			_pPool(std::exchange(other._pPool, nullptr)) {}
+
+		void operator()(type* pMem)
+		{
+			_pPool->destruct(pMem);
+		}
+
+	private:
+		pool_type* _pPool;
+	};
+
+	typedef std::unique_ptr<type, Deletor> unique_ptr;
+
+	// flags is a combination of VirtualMemory::Flags.
+	DynamicPoolAllocator(size_t pool_size, int flags = VirtualMemory::NONE) :
+		_pool_size(pool_size),
+		_pool(allocatePool(pool_size, flags)),
+		_committed_size(VirtualMemory::roundToPages(pool_size * sizeof(PoolEntry)))
+	{
+		reset();
+	}
+
+	DynamicPoolAllocator(const DynamicPoolAllocator&) = delete;
+	DynamicPoolAllocator& operator=(const DynamicPoolAllocator&) = delete;
+
+	~DynamicPoolAllocator()
+	{
+		VirtualMemory::release(_pool, _pool_size * sizeof(PoolEntry));
+	}
+
+	void reset()
+	{
+		_allocation_count = 0;
+		_next_free = nullptr;
+		_next_untouched = 0;
+	}
+
+	size_t getPoolSize() const { return _pool_size; }
+	unsigned int getFreeCount() const { return (unsigned int)(_pool_size - _allocation_count); }
+	unsigned int getAllocCount() const { return (unsigned int)_allocation_count; }
+	// The number of bytes of the pool's memory that haven't been handed back to the OS by compact.
+	size_t getCommittedSize() const { return _committed_size; }
+
+	template <class... _Types>
+	type* construct(_Types&&... _Args)
+	{
+		if (_allocation_count == _pool_size) throw std::bad_alloc();
+		PoolEntry* allocation = takeFreeEntry();
+		if (allocation == nullptr)
+		{
+			// The pages past the last live item may have been handed back by compact.
+			size_t end = (_next_untouched + 1) * sizeof(PoolEntry);
+			if (end > _committed_size) commitPages(end);
+			allocation = &_pool[_next_untouched++];
+		}
+		_allocation_count++;
+		allocation->next = const_cast<PoolEntry*>(&ENTRY_IN_USE);
+		return new(allocation->mem) type(std::forward<_Types>(_Args)...);
+	}
+
+	void destruct(type* pMem)
+	{
+		PoolEntry* pEntry = getEntry(pMem);
+		verifyEntryWithinPool(pEntry);
+		pMem->~type();
+		pEntry->next = _next_free;
+		_next_free = pEntry;
+		_allocation_count--;
+	}
+
+	// Moves live items from the end of the pool into free slots nearer the front until either the
+	// live items are packed together at the front or the time budget runs out. Once fully compacted
+	// the pages past the last live item are handed back to the OS. Returns true if the pool is
+	// fully compacted, false if the budget ran out first and compact should be called again.
+	//
+	// onRelocate(pFrom, pTo) is called with the old and new address of each item that is moved, so
+	// that anything holding pointers to it can be updated. The item has already been moved by then
+	// so pFrom must only be used for looking things up and never dereferenced.
+	template<class Func>
+	bool compact(std::chrono::nanoseconds budget, Func onRelocate)
+	{
+		static_assert(std::is_move_constructible<type>::value, "Only movable types can be compacted");
+		auto start = std::chrono::steady_clock::now();
+		size_t steps = 0;
+		while (_next_untouched != 0)
+		{
+			// Reading the clock isn't free so only check it every so often.
+			if ((++steps % 64) == 0 && std::chrono::steady_clock::now() - start >= budget) return false;
+
+			PoolEntry* pLast = &_pool[_next_untouched - 1];
+			if (pLast->next != &ENTRY_IN_USE)
+			{
+				// Free slots at the end are dropped rather than moved. They may still be on the
+				// free list, takeFreeEntry skips them.
+				_next_untouched--;
+				continue;
+			}
+
+			// Any free slot still in the pool is before the last live item.
+			PoolEntry* pFree = takeFreeEntry();
+			if (pFree == nullptr) break;
+			relocate(pLast, pFree, onRelocate);
+			_next_untouched--;
+		}
+
+		// Anything left on the free list was dropped from the end, so the list can be cleared and
+		// nothing past the last live item is needed any more.
+		_next_free = nullptr;
+		size_t used = VirtualMemory::roundToPages(_next_untouched * sizeof(PoolEntry));
+		if (used < _committed_size)
+		{
+			VirtualMemory::decommit(reinterpret_cast<char*>(_pool) + used, _committed_size - used);
+			_committed_size = used;
+		}
+		return true;
+	}
+
+	// As above, for when nothing holds on to pointers to the items.
+	bool compact(std::chrono::nanoseconds budget = std::chrono::nanoseconds::max())
+	{
+		return compact(budget, [](type*, type*) {});
+	}
+
+	template <class... _Types>
+	std::shared_ptr<type> make_shared(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return std::shared_ptr<type>(pItem, Deletor(this));
+	}
+
+	template <class... _Types>
+	unique_ptr make_unique(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return unique_ptr(pItem, Deletor(this));
+	}
+
+private:
+	struct PoolEntry
+	{
+		PoolEntry* next;
+		alignas(type) char mem[sizeof(type)];
+	};
+
+	static constexpr PoolEntry ENTRY_IN_USE = PoolEntry();
+
+	static PoolEntry* allocatePool(size_t pool_size, int flags)
+	{
+		// Guard against the size calculation overflowing for silly pool sizes.
+		if (pool_size > SIZE_MAX / sizeof(PoolEntry)) throw std::bad_alloc();
+		return static_cast<PoolEntry*>(VirtualMemory::allocate(pool_size * sizeof(PoolEntry), flags));
+	}
+
+	// Pops the next free slot, or returns nullptr if there isn't one. Slots dropped from the end of
+	// the pool by compact are discarded as they come up, they are reused by bumping
+	// _next_untouched instead. The list only needs to be empty for construct to start bumping
+	// again, so any slot left on it that is past _next_untouched must have been dropped.
+	PoolEntry* takeFreeEntry()
+	{
+		while (_next_free != nullptr)
+		{
+			PoolEntry* pEntry = _next_free;
+			_next_free = pEntry->next;
+			if (pEntry < &_pool[_next_untouched]) return pEntry;
+		}
+		return nullptr;
+	}
+
+	void commitPages(size_t end)
+	{
+		size_t committed = VirtualMemory::roundToPages(end);
+		VirtualMemory::commit(reinterpret_cast<char*>(_pool) + _committed_size, committed - _committed_size);
+		_committed_size = committed;
+	}
+
+	template<class Func>
+	void relocate(PoolEntry* pFrom, PoolEntry* pTo, Func& onRelocate)
+	{
+		type* pFromItem = reinterpret_cast<type*>(pFrom->mem);
+		type* pToItem;
+		try
+		{
+			pToItem = new(pTo->mem) type(std::move(*pFromItem));
+		}
+		catch (...)
+		{
+			pTo->next = _next_free;
+			_next_free = pTo;
+			throw;
+		}
+		pFromItem->~type();
+		pTo->next = const_cast<PoolEntry*>(&ENTRY_IN_USE);
+		pFrom->next = nullptr;
+		onRelocate(pFromItem, pToItem);
+	}
+
+	PoolEntry* getEntry(type* pMem)
+	{
+		auto raw = reinterpret_cast<char*>(pMem);
+		raw -= offsetof(PoolEntry, mem);
+		return reinterpret_cast<PoolEntry*>(raw);
+	}
+
+	void verifyEntryWithinPool(PoolEntry* pEntry)
+	{
+		if (pEntry < _pool || pEntry >= &_pool[_pool_size]) throw std::invalid_argument("Allocation is not within this pool");
+		// reset doesn't clear the in-use markers, so a slot from before the last reset still has
+		// one. Every slot below _next_untouched has been handed out again since then.
+		if (pEntry >= &_pool[_next_untouched] || pEntry->next != &ENTRY_IN_USE) throw std::invalid_argument("Allocation already appears to have been destructed");
+	}
+
+	const size_t _pool_size;
+	PoolEntry* const _pool;
+	size_t _allocation_count;
+	PoolEntry* _next_free;
+	// Index of the first slot that has never been allocated since the last reset.
+	size_t _next_untouched;
+	size_t _committed_size;
+};
+
+template<class type>
+constexpr typename DynamicPoolAllocator<type>::PoolEntry DynamicPoolAllocator<type>::ENTRY_IN_USE;
@@ -0,0 +1,254 @@
+/*
+ * A variation of the PoolAllocator that grows on demand rather than failing once a fixed number of
+ * items have been allocated.
+ * The pool is made up of fixed size "slabs", each of which is a small pool in its own right with
+ * its own free list. When every slab is full a new one is allocated from the heap, and slabs that
+ * have become completely empty can be handed back again with releaseEmptySlabs. This means the
+ * pool only needs to be as large as the current load rather than the worst case peak load.
+ *
+ * Allocation and release are still O(1) from the free list's point of view. Slabs with free
+ * slots are kept in an intrusive linked list so that we never need to search for space. Finding
+ * which slab an allocation belongs to on release is a binary search over the slab addresses, which
+ * is also how we verify that the allocation belongs to this pool.
+ */
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+template<class type, size_t slab_size, size_t max_slabs = SIZE_MAX>
+class GrowablePoolAllocator
+{
+	static_assert(slab_size > 0, "Slabs must contain at least one item");
+	// Slabs come from new which, before C++17, only guarantees the alignment of max_align_t.
+	static_assert(alignof(type) <= alignof(std::max_align_t), "Over-aligned types aren't supported by GrowablePoolAllocator");
+
+public:
+	typedef GrowablePoolAllocator<type, slab_size, max_slabs> pool_type;
+
+	// Same as PoolAllocator::Deletor, routes delete requests from smart pointers back to the pool.
+	class Deletor final
+	{
+	public:
+		Deletor(pool_type* pPool) noexcept:
+			_pPool(pPool) {}
+
+		Deletor(const Deletor& other) noexcept:
+			_pPool(other._pPool) {}
+
+		Deletor(Deletor&& other) noexcept :
+			_pPool(std::exchange(other._pPool, nullptr)) {}
+
+		void operator()(type* pMem)
+		{
+			_pPool->destruct(pMem);
+		}
+
+	private:
+		pool_type* _pPool;
+	};
+
+	typedef std::unique_ptr<type, Deletor> unique_ptr;
+
+	// No memory is allocated until the first item is constructed.
+	GrowablePoolAllocator() :
+		_allocation_count(0),
+		_available(nullptr)
+	{
+
+	}
+
+	GrowablePoolAllocator(const GrowablePoolAllocator&) = delete;
+	GrowablePoolAllocator& operator=(const GrowablePoolAllocator&) = delete;
+
+	~GrowablePoolAllocator()
+	{
+		// As with PoolAllocator, we don't destruct items that are still allocated. We do however
+		// need to return the slab memory as it came from the heap.
+		for (auto pSlab : _slabs)
+			delete pSlab;
+	}
+
+	// Marks every slot as free again but keeps hold of the slabs. Call releaseEmptySlabs
+	// afterwards to return the memory too.
+	void reset()
+	{
+		_allocation_count = 0;
+		_available = nullptr;
+		for (auto pSlab : _slabs)
+		{
+			pSlab->reset();
+			pushAvailable(pSlab);
+		}
+	}
+
+	// The pool size is the current capacity, which changes as slabs are added and released.
+	size_t getPoolSize() const { return _slabs.size() * slab_size; }
+	size_t getSlabSize() const { return slab_size; }
+	size_t getSlabCount() const { return _slabs.size(); }
+	unsigned int getFreeCount() const { return (unsigned int)(getPoolSize() - _allocation_count); }
+	unsigned int getAllocCount() const { return (unsigned int)_allocation_count; }
+
+	template <class... _Types>
+	type* construct(_Types&&... _Args)
+	{
+		if (_available == nullptr) addSlab();
+
+		Slab* pSlab = _available;
+		PoolEntry* allocation = pSlab->next_free;
+		pSlab->next_free = allocation->next;
+		pSlab->allocation_count++;
+		_allocation_count++;
+		// A full slab has nothing left to offer so it drops out of the available list until
+		// something is released back to it.
+		if (pSlab->allocation_count == slab_size) removeAvailable(pSlab);
+
+		allocation->next = const_cast<PoolEntry*>(&ENTRY_IN_USE);
+		return new(allocation->mem) type(std::forward<_Types>(_Args)...);
+	}
+
+	void destruct(type* pMem)
+	{
+		PoolEntry* pEntry = getEntry(pMem);
+		Slab* pSlab = verifyEntryWithinPool(pEntry);
+		pMem->~type();
+
+		pEntry->next = pSlab->next_free;
+		pSlab->next_free = pEntry;
+		// The slab has space again so it goes back on the available list.
+		if (pSlab->allocation_count == slab_size) pushAvailable(pSlab);
+		pSlab->allocation_count--;
+		_allocation_count--;
+	}
+
+	// Returns any slabs that have no live allocations back to the heap. Returns the number of slabs
+	// that were released.
+	size_t releaseEmptySlabs()
+	{
+		size_t released = 0;
+		for (size_t i = 0; i < _slabs.size();)
+		{
+			Slab* pSlab = _slabs[i];
+			if (pSlab->allocation_count != 0)
+			{
+				i++;
+				continue;
+			}
+			removeAvailable(pSlab);
+			_slabs.erase(_slabs.begin() + i);
+			delete pSlab;
+			released++;
+		}
+		return released;
+	}
+
+	template <class... _Types>
+	std::shared_ptr<type> make_shared(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return std::shared_ptr<type>(pItem, Deletor(this));
+	}
+
+	template <class... _Types>
+	unique_ptr make_unique(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return unique_ptr(pItem, Deletor(this));
+	}
+
+private:
+	struct PoolEntry
+	{
+		PoolEntry* next;
+		alignas(type) char mem[sizeof(type)];
+	};
+
+	struct Slab
+	{
+		Slab()
+		{
+			reset();
+		}
+
+		void reset()
+		{
+			allocation_count = 0;
+			next_free = nullptr;
+			for (size_t i = slab_size; i > 0; i--)
+			{
+				entries[i - 1].next = next_free;
+				next_free = &entries[i - 1];
+			}
+		}
+
+		// Links for the list of slabs that have free slots.
+		Slab* prev_available;
+		Slab* next_available;
+		PoolEntry* next_free;
+		size_t allocation_count;
+		PoolEntry entries[slab_size];
+	};
+
+	static constexpr PoolEntry ENTRY_IN_USE = PoolEntry();
+
+	void addSlab()
+	{
+		if (_slabs.size() == max_slabs) throw std::bad_alloc();
+		std::unique_ptr<Slab> pSlab(new Slab());
+		// Slabs are kept sorted by address so that we can binary search them on release.
+		auto pos = std::upper_bound(_slabs.begin(), _slabs.end(), pSlab.get(), std::less<Slab*>());
+		_slabs.insert(pos, pSlab.get());
+		pushAvailable(pSlab.release());
+	}
+
+	void pushAvailable(Slab* pSlab)
+	{
+		pSlab->prev_available = nullptr;
+		pSlab->next_available = _available;
+		if (_available) _available->prev_available = pSlab;
+		_available = pSlab;
+	}
+
+	void removeAvailable(Slab* pSlab)
+	{
+		if (pSlab->prev_available) pSlab->prev_available->next_available = pSlab->next_available;
+		else _available = pSlab->next_available;
+		if (pSlab->next_available) pSlab->next_available->prev_available = pSlab->prev_available;
+	}
+
+	PoolEntry* getEntry(type* pMem)
+	{
+		auto raw = reinterpret_cast<char*>(pMem);
+		raw -= offsetof(PoolEntry, mem);
+		return reinterpret_cast<PoolEntry*>(raw);
+	}
+
+	Slab* verifyEntryWithinPool(PoolEntry* pEntry)
+	{
+		// Find the last slab that starts at or before the entry, the entry can only belong to that
+		// slab. std::less is used as comparing unrelated pointers with < isn't well defined.
+		auto pos = std::upper_bound(_slabs.begin(), _slabs.end(), pEntry, [](PoolEntry* pEntry, Slab* pSlab) {
+			return std::less<const void*>()(pEntry, pSlab);
+		});
+		if (pos == _slabs.begin()) throw std::invalid_argument("Allocation is not within this pool");
+		Slab* pSlab = *(pos - 1);
+		if (std::less<PoolEntry*>()(pEntry, pSlab->entries) || !std::less<PoolEntry*>()(pEntry, &pSlab->entries[slab_size])) throw std::invalid_argument("Allocation is not within this pool");
+		if (pEntry->next != &ENTRY_IN_USE) throw std::invalid_argument("Allocation already appears to have been destructed");
+		return pSlab;
+	}
+
+	size_t _allocation_count;
+	// Slabs with at least one free slot.
+	Slab* _available;
+	// All slabs owned by this pool, sorted by address.
+	std::vector<Slab*> _slabs;
+};
+
+template<class type, size_t slab_size, size_t max_slabs>
+constexpr typename GrowablePoolAllocator<type, slab_size, max_slabs>::PoolEntry GrowablePoolAllocator<type, slab_size, max_slabs>::ENTRY_IN_USE;
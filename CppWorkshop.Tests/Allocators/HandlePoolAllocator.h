@@ -0,0 +1,150 @@
+/*
+ * A pool that hands out handles to its items rather than pointers.
+ *
+ * A raw pointer into a pool can't tell whether the item it points at has been released, or even
+ * released and reused for something else. The sentinel check in destruct catches some double
+ * releases but nothing stops a stale pointer being dereferenced.
+ *
+ * A handle is a 32 bit slot index plus a 32 bit generation count. Every slot has its own generation
+ * which is bumped each time an item in it is released, so a handle to a released item no longer
+ * matches its slot and can be detected as stale no matter how many times the slot has been reused
+ * since. Resolving a handle to a pointer is an array lookup and a comparison. This is the approach
+ * commonly used by entity-component systems to let components refer to each other safely across
+ * frames.
+ *
+ * Pointers returned by resolve are only valid until the item is released, so they shouldn't be
+ * held on to; hold the handle instead.
+ */
+#pragma once
+#include <new>
+#include <stdexcept>
+#include <stdint.h>
+#include <utility>
+
+template<class type, size_t pool_size>
+class HandlePoolAllocator
+{
+	static_assert(pool_size < 0xFFFFFFFE, "Pool is too large to be indexed by a 32 bit handle");
+
+public:
+	typedef HandlePoolAllocator<type, pool_size> pool_type;
+
+	struct Handle
+	{
+		uint32_t index;
+		// Generations start at 1 so that a default constructed handle never resolves.
+		uint32_t generation;
+
+		bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const Handle& other) const { return !(*this == other); }
+	};
+
+	HandlePoolAllocator() :
+		_allocation_count(0)
+	{
+		for (size_t i = 0; i < pool_size; i++)
+			_generations[i] = 1;
+		reset();
+	}
+
+	~HandlePoolAllocator()
+	{
+		// Unlike the pointer based pools, the items here are only reachable through the pool so we
+		// destruct anything still alive.
+		clear();
+	}
+
+	HandlePoolAllocator(const HandlePoolAllocator&) = delete;
+	HandlePoolAllocator& operator=(const HandlePoolAllocator&) = delete;
+
+	// Destructs every live item, invalidating all outstanding handles.
+	void reset()
+	{
+		clear();
+		_allocation_count = 0;
+		_next_free = pool_size != 0 ? 0 : END_OF_LIST;
+		for (size_t i = 0; i < pool_size; i++)
+			_next[i] = (uint32_t)(i + 1 < pool_size ? i + 1 : END_OF_LIST);
+	}
+
+	size_t getPoolSize() const { return pool_size; }
+	unsigned int getFreeCount() const { return (unsigned int)(pool_size - _allocation_count); }
+	unsigned int getAllocCount() const { return (unsigned int)_allocation_count; }
+
+	template <class... _Types>
+	Handle construct(_Types&&... _Args)
+	{
+		if (_allocation_count == pool_size) throw std::bad_alloc();
+		uint32_t index = _next_free;
+		new(&_items[index]) type(std::forward<_Types>(_Args)...);
+		_allocation_count++;
+		_next_free = _next[index];
+		_next[index] = ENTRY_IN_USE;
+		return Handle{ index, _generations[index] };
+	}
+
+	void destruct(Handle handle)
+	{
+		if (handle.index >= pool_size) throw std::invalid_argument("Allocation is not within this pool");
+		if (!isValid(handle)) throw std::invalid_argument("Allocation already appears to have been destructed");
+		release(handle.index);
+	}
+
+	// Returns true if the handle refers to a live item.
+	bool isValid(Handle handle) const
+	{
+		return handle.index < pool_size && _generations[handle.index] == handle.generation && _next[handle.index] == ENTRY_IN_USE;
+	}
+
+	// Returns the item a handle refers to, or nullptr if the handle is stale.
+	type* resolve(Handle handle)
+	{
+		if (!isValid(handle)) return nullptr;
+		return reinterpret_cast<type*>(&_items[handle.index]);
+	}
+
+	const type* resolve(Handle handle) const
+	{
+		return const_cast<pool_type*>(this)->resolve(handle);
+	}
+
+private:
+	static constexpr uint32_t END_OF_LIST = 0xFFFFFFFE;
+	static constexpr uint32_t ENTRY_IN_USE = 0xFFFFFFFF;
+
+	struct ItemStorage
+	{
+		alignas(type) char mem[sizeof(type)];
+	};
+
+	void release(uint32_t index)
+	{
+		reinterpret_cast<type*>(&_items[index])->~type();
+		// Skip 0 when the generation wraps so that default constructed handles stay invalid.
+		if (++_generations[index] == 0) _generations[index] = 1;
+		_next[index] = _next_free;
+		_next_free = index;
+		_allocation_count--;
+	}
+
+	void clear()
+	{
+		if (_allocation_count == 0) return;
+		for (uint32_t i = 0; i < pool_size; i++)
+			if (_next[i] == ENTRY_IN_USE) release(i);
+	}
+
+	// As with DensePoolAllocator, the items are kept separate from the book keeping so that they are
+	// packed together.
+	ItemStorage _items[pool_size];
+	uint32_t _generations[pool_size];
+	uint32_t _next[pool_size];
+	size_t _allocation_count;
+	uint32_t _next_free;
+};
+
+template<class type, size_t pool_size>
+constexpr uint32_t HandlePoolAllocator<type, pool_size>::END_OF_LIST;
+
+template<class type, size_t pool_size>
+constexpr uint32_t HandlePoolAllocator<type, pool_size>::ENTRY_IN_USE;
@@ -0,0 +1,344 @@
+/*
+ * Optional sampling heap profiler for TrackingAllocator, selected with its sampling_policy
+ * parameter. This works along the same lines as tcmalloc's heap sampling.
+ *
+ * Recording where every allocation came from is far too slow to leave running in production, so
+ * instead roughly one allocation in every N bytes allocated is sampled. A sampled allocation has
+ * its stack captured and is kept in a table until it's released. Bigger allocations are more
+ * likely to be sampled, and pprof knows the sampling period so it scales the samples back up,
+ * which still gives a good estimate of where the memory is going.
+ *
+ * The gap to the next sample is drawn from an exponential distribution with the sampling period
+ * as its mean, so a regular allocation pattern can't line up with the samples. Each thread counts
+ * down the bytes to its own next sample, so an allocation that isn't sampled only costs a
+ * decrement of that count. Only sampled allocations and their releases take the lock.
+ *
+ * The tables have a fixed size so the profiler never needs to allocate more memory once it's
+ * running. Samples that don't fit are dropped and counted instead.
+ *
+ * writeProfile writes the samples in the legacy text heap profile format, which pprof reads
+ * directly:
+ *   pprof --text <program> heap.prof
+ *
+ * TrackingAllocator doesn't sample by default, so this header has to be included alongside it to
+ * use HeapSampler. That keeps the includes needed here out of everything else using
+ * TrackingAllocator.
+ */
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+// Only needed for CaptureStackBackTrace. The macros are undefined again afterwards so that they
+// don't change what the rest of the including file sees.
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#define HEAP_SAMPLER_UNDEF_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#define HEAP_SAMPLER_UNDEF_NOMINMAX
+#endif
+#include <windows.h>
+#ifdef HEAP_SAMPLER_UNDEF_LEAN_AND_MEAN
+#undef WIN32_LEAN_AND_MEAN
+#undef HEAP_SAMPLER_UNDEF_LEAN_AND_MEAN
+#endif
+#ifdef HEAP_SAMPLER_UNDEF_NOMINMAX
+#undef NOMINMAX
+#undef HEAP_SAMPLER_UNDEF_NOMINMAX
+#endif
+#else
+#include <execinfo.h>
+#endif
+
+class HeapSampler
+{
+public:
+	static constexpr bool SAMPLING = true;
+	static constexpr size_t DEFAULT_SAMPLE_PERIOD = 512 * 1024;
+	static constexpr int MAX_STACK_DEPTH = 32;
+	// The number of distinct stacks that can be recorded.
+	static constexpr size_t MAX_STACKS = 1024;
+	// The number of sampled allocations that can be live at once.
+	static constexpr size_t MAX_LIVE_SAMPLES = 4096;
+
+	HeapSampler() :
+		_pStacks(nullptr),
+		_pLiveSamples(nullptr),
+		_liveSampleCount(0),
+		_droppedSampleCount(0)
+	{
+
+	}
+
+	HeapSampler(const HeapSampler&) = delete;
+	HeapSampler& operator=(const HeapSampler&) = delete;
+
+	~HeapSampler()
+	{
+		free(_pStacks);
+		free(_pLiveSamples);
+	}
+
+	static size_t getSamplePeriod() { return s_samplePeriod.load(std::memory_order_relaxed); }
+
+	// The period is shared by every sampler. The calling thread starts counting down to its next
+	// sample with the new period straight away, other threads switch after their next sample.
+	static void setSamplePeriod(size_t bytes)
+	{
+		s_samplePeriod.store(bytes != 0 ? bytes : 1, std::memory_order_relaxed);
+		s_bytesUntilSample = pickSampleGap();
+	}
+
+	// The number of sampled allocations that haven't been released yet.
+	size_t getLiveSampleCount() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _liveSampleCount;
+	}
+
+	// Samples that were dropped because one of the tables was full.
+	size_t getDroppedSampleCount() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _droppedSampleCount;
+	}
+
+	// Writes every stack that has been sampled, with the live and total sampled allocations for
+	// each, in pprof's legacy heap profile format. On Linux the process's memory map is included
+	// so that pprof can symbolise the addresses.
+	void writeProfile(FILE* pFile) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		size_t liveCount = 0, liveBytes = 0, allocCount = 0, allocBytes = 0;
+		for (size_t i = 0; _pStacks != nullptr && i < MAX_STACKS; i++)
+		{
+			liveCount += _pStacks[i].liveCount;
+			liveBytes += _pStacks[i].liveBytes;
+			allocCount += _pStacks[i].allocCount;
+			allocBytes += _pStacks[i].allocBytes;
+		}
+
+		fprintf(pFile, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n", liveCount, liveBytes, allocCount, allocBytes, getSamplePeriod());
+		for (size_t i = 0; _pStacks != nullptr && i < MAX_STACKS; i++)
+		{
+			const Stack& stack = _pStacks[i];
+			if (stack.depth == 0) continue;
+			fprintf(pFile, "%zu: %zu [%zu: %zu] @", stack.liveCount, stack.liveBytes, stack.allocCount, stack.allocBytes);
+			for (int frame = 0; frame < stack.depth; frame++)
+				fprintf(pFile, " 0x%llx", (unsigned long long)(uintptr_t)stack.frames[frame]);
+			fputc('\n', pFile);
+		}
+
+#ifndef _WIN32
+		fputs("\nMAPPED_LIBRARIES:\n", pFile);
+		FILE* pMaps = fopen("/proc/self/maps", "r");
+		if (pMaps != nullptr)
+		{
+			char buffer[4096];
+			size_t read;
+			while ((read = fread(buffer, 1, sizeof(buffer), pMaps)) > 0)
+				fwrite(buffer, 1, read, pFile);
+			fclose(pMaps);
+		}
+#endif
+	}
+
+protected:
+	// Called for every allocation. This is the fast path so it does as little as possible, it
+	// returns true when the allocation should be sampled.
+	bool countSampleBytes(size_t size)
+	{
+		if ((s_bytesUntilSample -= (int64_t)size) >= 0) return false;
+		s_bytesUntilSample = pickSampleGap();
+		return true;
+	}
+
+	// Returns false if the sample couldn't be recorded, in which case releaseSample mustn't be
+	// called for it.
+	bool recordSample(void* pMem, size_t size)
+	{
+		// Capture the stack before taking the lock, it's the slowest part.
+		void* frames[MAX_STACK_DEPTH];
+		int depth = captureStack(frames);
+		uint64_t stackHash = hashStack(frames, depth);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_pStacks == nullptr)
+		{
+			// calloc rather than new so that a profiler used by a replaced global operator new
+			// doesn't call back into itself.
+			_pStacks = static_cast<Stack*>(calloc(MAX_STACKS, sizeof(Stack)));
+			_pLiveSamples = static_cast<LiveSample*>(calloc(LIVE_TABLE_SIZE, sizeof(LiveSample)));
+			if (_pStacks == nullptr || _pLiveSamples == nullptr)
+			{
+				free(_pStacks);
+				free(_pLiveSamples);
+				_pStacks = nullptr;
+				_pLiveSamples = nullptr;
+				_droppedSampleCount++;
+				return false;
+			}
+		}
+
+		Stack* pStack = _liveSampleCount < MAX_LIVE_SAMPLES ? findStack(frames, depth, stackHash) : nullptr;
+		if (pStack == nullptr)
+		{
+			_droppedSampleCount++;
+			return false;
+		}
+
+		// Linear probing in a table that's never more than half full, so there's always an empty
+		// slot and it's never far away.
+		size_t index = hashPointer(pMem);
+		while (_pLiveSamples[index].pMem != nullptr)
+			index = (index + 1) % LIVE_TABLE_SIZE;
+		_pLiveSamples[index] = { pMem, size, (uint32_t)(pStack - _pStacks) };
+		_liveSampleCount++;
+
+		pStack->liveCount++;
+		pStack->liveBytes += size;
+		pStack->allocCount++;
+		pStack->allocBytes += size;
+		return true;
+	}
+
+	void releaseSample(void* pMem)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		size_t index = hashPointer(pMem);
+		while (_pLiveSamples[index].pMem != pMem)
+			index = (index + 1) % LIVE_TABLE_SIZE;
+
+		Stack& stack = _pStacks[_pLiveSamples[index].stack];
+		stack.liveCount--;
+		stack.liveBytes -= _pLiveSamples[index].size;
+		_liveSampleCount--;
+
+		// Removing an entry from a linear probed table would break the chain for any entries after
+		// it that were pushed along by collisions. So rather than leaving a marker, shift those
+		// entries back into the gap.
+		size_t gap = index;
+		for (size_t next = (gap + 1) % LIVE_TABLE_SIZE; _pLiveSamples[next].pMem != nullptr; next = (next + 1) % LIVE_TABLE_SIZE)
+		{
+			size_t home = hashPointer(_pLiveSamples[next].pMem);
+			// An entry can only move back if its home slot isn't between the gap and where it is.
+			bool canMove = gap <= next ? (home <= gap || home > next) : (home <= gap && home > next);
+			if (!canMove) continue;
+			_pLiveSamples[gap] = _pLiveSamples[next];
+			gap = next;
+		}
+		_pLiveSamples[gap] = {};
+	}
+
+private:
+	static constexpr size_t LIVE_TABLE_SIZE = MAX_LIVE_SAMPLES * 2;
+
+	struct Stack
+	{
+		uint64_t hash;
+		int depth;
+		void* frames[MAX_STACK_DEPTH];
+		size_t liveCount;
+		size_t liveBytes;
+		size_t allocCount;
+		size_t allocBytes;
+	};
+
+	struct LiveSample
+	{
+		void* pMem;
+		size_t size;
+		uint32_t stack;
+	};
+
+	static int captureStack(void** frames)
+	{
+#ifdef _WIN32
+		return CaptureStackBackTrace(0, MAX_STACK_DEPTH, frames, nullptr);
+#else
+		return backtrace(frames, MAX_STACK_DEPTH);
+#endif
+	}
+
+	static uint64_t hashStack(void* const* frames, int depth)
+	{
+		// FNV-1a over the addresses.
+		uint64_t hash = 14695981039346656037ull;
+		for (int i = 0; i < depth; i++)
+		{
+			hash ^= (uint64_t)(uintptr_t)frames[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static size_t hashPointer(const void* pMem)
+	{
+		// Heap addresses are aligned, so mix the higher bits down before taking the remainder.
+		uint64_t value = (uint64_t)(uintptr_t)pMem;
+		value ^= value >> 17;
+		value *= 0x9e3779b97f4a7c15ull;
+		return (size_t)(value >> 32) % LIVE_TABLE_SIZE;
+	}
+
+	// Finds the entry for a stack, adding it if it's new. Returns nullptr if the table is full.
+	Stack* findStack(void* const* frames, int depth, uint64_t stackHash)
+	{
+		for (size_t probe = 0, index = stackHash % MAX_STACKS; probe < MAX_STACKS; probe++, index = (index + 1) % MAX_STACKS)
+		{
+			Stack& stack = _pStacks[index];
+			if (stack.depth == 0)
+			{
+				stack.hash = stackHash;
+				stack.depth = depth;
+				for (int i = 0; i < depth; i++)
+					stack.frames[i] = frames[i];
+				return &stack;
+			}
+			if (stack.hash == stackHash && stack.depth == depth && equalFrames(stack.frames, frames, depth))
+				return &stack;
+		}
+		return nullptr;
+	}
+
+	static bool equalFrames(void* const* a, void* const* b, int depth)
+	{
+		for (int i = 0; i < depth; i++)
+			if (a[i] != b[i]) return false;
+		return true;
+	}
+
+	// Draws the number of bytes until the next sample from an exponential distribution.
+	static int64_t pickSampleGap()
+	{
+		// xorshift64*, seeded differently on each thread. Good enough for picking sample points
+		// and much cheaper to keep per thread than a std::mt19937.
+		static thread_local uint64_t s_random = 0x9e3779b97f4a7c15ull ^ (uint64_t)(uintptr_t)&s_random;
+		s_random ^= s_random >> 12;
+		s_random ^= s_random << 25;
+		s_random ^= s_random >> 27;
+		// A uniform value in (0, 1], from the top 53 bits.
+		double uniform = ((s_random * 0x2545f4914f6cdd1dull >> 11) + 1) * (1.0 / 9007199254740992.0);
+		double gap = -std::log(uniform) * (double)getSamplePeriod();
+		return gap < 1.0 ? 1 : gap > 1e18 ? (int64_t)1e18 : (int64_t)gap;
+	}
+
+	inline static std::atomic<size_t> s_samplePeriod{ DEFAULT_SAMPLE_PERIOD };
+	// Starts at the period rather than a random gap so that it needs no dynamic initialisation,
+	// which would add a check to every access.
+	inline static thread_local int64_t s_bytesUntilSample = DEFAULT_SAMPLE_PERIOD;
+
+	mutable std::mutex _mutex;
+	// Both tables are allocated the first time something is sampled.
+	Stack* _pStacks;
+	LiveSample* _pLiveSamples;
+	size_t _liveSampleCount;
+	size_t _droppedSampleCount;
+};
@@ -0,0 +1,256 @@
+/*
+ * A thread safe pool allocator that puts a small per-thread cache of free slots, a "magazine", in
+ * front of the shared pool.
+ *
+ * Even a lock-free pool has a single free list head that every thread has to update, and the
+ * cache line holding it bounces between cores on every allocation. With a magazine, construct
+ * pops a slot from the calling thread's own cache and destruct pushes it back, so the common
+ * alloc/free pair only touches thread-local memory. The shared pool (the "depot") is only visited
+ * when a magazine runs empty or fills up, and then a whole batch of slots is moved in one go so
+ * the cost of taking the depot lock is shared across many allocations.
+ *
+ * There are some caveats to be aware of:
+ *  - Slots sitting in a thread's magazine are not available to other threads, so a pool needs to
+ *    be sized with roughly magazine_size spare slots per thread.
+ *  - getFreeCount only reports the slots held by the depot. Slots cached by threads count as
+ *    allocated.
+ *  - Each thread has one magazine per pool type. If a thread alternates between two pools of the
+ *    same type, the magazine is flushed back to the previous pool each time it switches.
+ *  - Magazines are flushed back when their thread exits, so the pool must outlive every thread that
+ *    uses it, or the threads must call releaseThreadCache before exiting.
+ */
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stddef.h>
+#include <stdexcept>
+#include <utility>
+
+template<class type, size_t pool_size, size_t magazine_size = 32>
+class MagazinePoolAllocator
+{
+	static_assert(magazine_size >= 2, "Magazines must be able to hold at least two slots");
+
+public:
+	typedef MagazinePoolAllocator<type, pool_size, magazine_size> pool_type;
+
+	// Same as PoolAllocator::Deletor, routes delete requests from smart pointers back to the pool.
+	class Deletor final
+	{
+	public:
+		Deletor(pool_type* pPool) noexcept:
+			_pPool(pPool) {}
+
+		Deletor(const Deletor& other) noexcept:
+			_pPool(other._pPool) {}
+
+		Deletor(Deletor&& other) noexcept :
+			_pPool(std::exchange(other._pPool, nullptr)) {}
+
+		void operator()(type* pMem)
+		{
+			_pPool->destruct(pMem);
+		}
+
+	private:
+		pool_type* _pPool;
+	};
+
+	typedef std::unique_ptr<type, Deletor> unique_ptr;
+
+	MagazinePoolAllocator() :
+		_generation(0)
+	{
+		reset();
+	}
+
+	~MagazinePoolAllocator()
+	{
+		// We can only reach the calling thread's magazine, other threads must have released
+		// theirs already.
+		Magazine& magazine = threadLocalMagazine();
+		if (magazine.pOwner == this) magazine.pOwner = nullptr;
+	}
+
+	// Not thread safe. Any slots cached by threads are abandoned, their magazines notice that the
+	// generation has changed and discard their contents the next time they are used.
+	void reset()
+	{
+		_generation++;
+		_free_count.store(pool_size, std::memory_order_relaxed);
+		_next_free = nullptr;
+		for (size_t i = 0; i < pool_size; i++)
+		{
+			_pool[i].next = _next_free;
+			_next_free = &_pool[i];
+		}
+	}
+
+	size_t getPoolSize() const { return pool_size; }
+	size_t getMagazineSize() const { return magazine_size; }
+	unsigned int getFreeCount() const { return (unsigned int)_free_count.load(std::memory_order_relaxed); }
+	unsigned int getAllocCount() const { return (unsigned int)(pool_size - _free_count.load(std::memory_order_relaxed)); }
+
+	template <class... _Types>
+	type* construct(_Types&&... _Args)
+	{
+		Magazine& magazine = threadMagazine();
+		// Only half fill the magazine so that a run of frees that follows doesn't immediately
+		// have to flush back to the depot.
+		if (magazine.count == 0 && refill(magazine, magazine_size / 2) == 0) throw std::bad_alloc();
+
+		PoolEntry* pEntry = magazine.slots[--magazine.count];
+		pEntry->next = const_cast<PoolEntry*>(&ENTRY_IN_USE);
+		return new(pEntry->mem) type(std::forward<_Types>(_Args)...);
+	}
+
+	void destruct(type* pMem)
+	{
+		PoolEntry* pEntry = getEntry(pMem);
+		verifyEntryWithinPool(pEntry);
+		pMem->~type();
+		pEntry->next = nullptr;
+
+		Magazine& magazine = threadMagazine();
+		// Flush half of a full magazine, keeping the other half for the allocations that follow.
+		if (magazine.count == magazine_size) flush(magazine, magazine_size / 2);
+		magazine.slots[magazine.count++] = pEntry;
+	}
+
+	template <class... _Types>
+	std::shared_ptr<type> make_shared(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return std::shared_ptr<type>(pItem, Deletor(this));
+	}
+
+	template <class... _Types>
+	unique_ptr make_unique(_Types&&... _Args)
+	{
+		type* pItem = construct(_Args...);
+		return unique_ptr(pItem, Deletor(this));
+	}
+
+	// Returns all of the slots cached by the calling thread to the depot.
+	void releaseThreadCache()
+	{
+		Magazine& magazine = threadLocalMagazine();
+		if (magazine.pOwner == this) returnMagazine(magazine);
+	}
+
+private:
+	struct PoolEntry
+	{
+		PoolEntry* next;
+		alignas(type) char mem[sizeof(type)];
+	};
+
+	struct Magazine
+	{
+		Magazine() :
+			pOwner(nullptr),
+			generation(0),
+			count(0)
+		{
+
+		}
+
+		~Magazine()
+		{
+			if (pOwner) pOwner->returnMagazine(*this);
+		}
+
+		pool_type* pOwner;
+		size_t generation;
+		size_t count;
+		PoolEntry* slots[magazine_size];
+	};
+
+	static constexpr PoolEntry ENTRY_IN_USE = PoolEntry();
+
+	static Magazine& threadLocalMagazine()
+	{
+		// There is one magazine per thread for each instantiation of this template rather than per
+		// pool instance, thread_local can only be applied to statics.
+		static thread_local Magazine t_magazine;
+		return t_magazine;
+	}
+
+	// Returns the calling thread's magazine, taking ownership of it for this pool if necessary.
+	Magazine& threadMagazine()
+	{
+		Magazine& magazine = threadLocalMagazine();
+		if (magazine.pOwner != this || magazine.generation != _generation)
+		{
+			if (magazine.pOwner != nullptr) magazine.pOwner->returnMagazine(magazine);
+			magazine.pOwner = this;
+			magazine.generation = _generation;
+			magazine.count = 0;
+		}
+		return magazine;
+	}
+
+	// Hands all of a magazine's slots back to the depot and detaches it from this pool. Slots from
+	// before a reset are already back in the depot and are simply dropped.
+	void returnMagazine(Magazine& magazine)
+	{
+		if (magazine.generation == _generation) flush(magazine, magazine.count);
+		magazine.count = 0;
+		magazine.pOwner = nullptr;
+	}
+
+	// Moves up to count slots from the depot into the magazine, returning the number moved.
+	size_t refill(Magazine& magazine, size_t count)
+	{
+		std::lock_guard<std::mutex> lock(_depot_mutex);
+		size_t moved = 0;
+		while (moved < count && _next_free != nullptr)
+		{
+			magazine.slots[magazine.count++] = _next_free;
+			_next_free = _next_free->next;
+			moved++;
+		}
+		_free_count.fetch_sub(moved, std::memory_order_relaxed);
+		return moved;
+	}
+
+	// Moves count slots from the top of the magazine back to the depot.
+	void flush(Magazine& magazine, size_t count)
+	{
+		std::lock_guard<std::mutex> lock(_depot_mutex);
+		for (size_t i = 0; i < count; i++)
+		{
+			PoolEntry* pEntry = magazine.slots[--magazine.count];
+			pEntry->next = _next_free;
+			_next_free = pEntry;
+		}
+		_free_count.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	PoolEntry* getEntry(type* pMem)
+	{
+		auto raw = reinterpret_cast<char*>(pMem);
+		raw -= offsetof(PoolEntry, mem);
+		return reinterpret_cast<PoolEntry*>(raw);
+	}
+
+	void verifyEntryWithinPool(PoolEntry* pEntry)
+	{
+		if (pEntry < _pool || pEntry >= &_pool[pool_size]) throw std::invalid_argument("Allocation is not within this pool");
+		if (pEntry->next != &ENTRY_IN_USE) throw std::invalid_argument("Allocation already appears to have been destructed");
+	}
+
+	// The generation is read on every call but only written by reset, so it is kept away from the
+	// depot which is written every time a magazine is refilled or flushed.
+	alignas(64) size_t _generation;
+	alignas(64) std::mutex _depot_mutex;
+	// Only changed with _depot_mutex held, but atomic so the counts can be read without it.
+	std::atomic<size_t> _free_count;
+	PoolEntry* _next_free;
+	alignas(64) PoolEntry _pool[pool_size];
+};
+
+template<class type, size_t pool_size, size_t magazine_size>
+constexpr typename MagazinePoolAllocator<type, pool_size, magazine_size>::PoolEntry MagazinePoolAllocator<type, pool_size, magazine_size>::ENTRY_IN_USE;
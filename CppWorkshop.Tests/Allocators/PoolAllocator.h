@@ -4,19 +4,167 @@
  * items, only single items per allocation request.
  * The pool does however support verifying release requests and providing shared_ptr/unique_ptr
  * wrappers in addition to raw pointers.
+ *
+ * Items are always placed at an address suitable for alignof(type). The optional slot_alignment
+ * parameter can be used to align and pad every slot to a larger boundary. Passing
+ * POOL_CACHE_LINE_ALIGNED gives every item its own cache line(s) so that items handed to different
+ * threads never suffer from false sharing.
+ * Note that before C++17, new doesn't respect alignments larger than alignof(std::max_align_t), so
+ * pools with over-aligned slots should be declared statically or on the stack.
+ *
+ * The checks made when releasing items are controlled by the check_policy parameter, see
+ * PoolChecks below. This lets release builds trade safety for speed on the hot path.
+ *
+ * The order released slots are reused in is controlled by the free_list_policy parameter, see
+ * PoolFreeList below.
+ *
+ * Usage counters such as the high water mark can be enabled with the telemetry_policy parameter,
+ * see PoolTelemetry.h. When enabled, getStats returns a snapshot of them.
+ *
+ * The pool isn't thread safe, but with the RemoteFrees policy other threads can release items
+ * through destruct_remote. See RemoteFrees below.
+ *
+ * Alongside the slots, the pool keeps a bitmap with one bit per slot recording which are in use.
+ * This allows for_each_live to visit every live item in address order, skipping over 64 empty
+ * slots at a time, which is much friendlier to the cache than chasing pointers held elsewhere.
  */
+#pragma once
+#include <atomic>
+#include <memory>
 #include <new>
+#include <stddef.h>
 #include <stdexcept>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+#include "BitOps.h"
+#include "PoolTelemetry.h"
+
+// Value for the slot_alignment parameter to pad every slot out to a whole number of cache lines.
+constexpr size_t POOL_CACHE_LINE_ALIGNED = 64;
+
+// Controls the validation a pool performs when items are released.
+//  - check_range: the item's address must be within the pool.
+//  - check_in_use: the item must currently be allocated, catching double releases.
+//  - poison_freed: released slots are filled with POISON and checked again before being reused,
+//    catching writes through dangling pointers.
+template<bool range, bool in_use, bool poison>
+struct PoolChecks
+{
+	static constexpr bool check_range = range;
+	static constexpr bool check_in_use = in_use;
+	static constexpr bool poison_freed = poison;
+	static constexpr unsigned char POISON = 0xDD;
+};
+
+// No validation at all, releasing an invalid pointer is undefined behaviour.
+typedef PoolChecks<false, false, false> NoPoolChecks;
+// Just the cheap address range check.
+typedef PoolChecks<true, false, false> RangePoolChecks;
+// Range and double release checks. This is the default.
+typedef PoolChecks<true, true, false> DefaultPoolChecks;
+// Everything, including poisoning of released slots.
+typedef PoolChecks<true, true, true> FullPoolChecks;
+
+// Controls the order in which released slots are handed out again.
+//  - LIFO: the most recently released slot is reused first. This is the cheapest and the slot is
+//    likely to still be in the cache, but after some churn items end up scattered around the pool
+//    in no particular order.
+//  - FIFO: the least recently released slot is reused first. Slots get the longest possible time
+//    to be flushed from the cache, which makes it less likely that a dangling pointer reads
+//    something plausible.
+//  - ADDRESS_ORDERED: the lowest free slot is reused first, found by searching the occupancy bitmap
+//    rather than following a list. Allocation costs a little more, but items allocated together
+//    sit together in memory and the live items stay packed towards the front of the pool.
+enum class FreeListOrder
+{
+	LIFO,
+	FIFO,
+	ADDRESS_ORDERED,
+};
+
+template<FreeListOrder free_list_order>
+struct PoolFreeList
+{
+	static constexpr FreeListOrder order = free_list_order;
+};
+
+// The default.
+typedef PoolFreeList<FreeListOrder::LIFO> LifoFreeList;
+typedef PoolFreeList<FreeListOrder::FIFO> FifoFreeList;
+typedef PoolFreeList<FreeListOrder::ADDRESS_ORDERED> AddressOrderedFreeList;
+
+// Controls whether threads other than the one that owns the pool can release items.
+//  - NoRemoteFrees: only the owning thread may use the pool. This is the default.
+//  - RemoteFrees: other threads may call destruct_remote. Rather than touching the free list, the
+//    item is destructed and its slot pushed on to a lock-free list of remote frees. The owning
+//    thread takes the whole list in one go the next time it constructs an item and moves the slots
+//    on to its free list. This suits producer/consumer pipelines where items are created on one
+//    thread and destroyed on another, as the threads never contend on the same free list. Until
+//    the owner reclaims them, remotely released slots still count as allocated.
+class NoRemoteFrees
+{
+protected:
+	bool hasRemoteFrees() const { return false; }
+	void* takeRemoteFrees() { return nullptr; }
+};
+
+class RemoteFrees
+{
+protected:
+	RemoteFrees() :
+		_remote_frees(nullptr)
+	{
+
+	}
+
+	// The slot's next field is used to link it into the list.
+	template<class Slot>
+	void pushRemoteFree(Slot* pSlot)
+	{
+		void* head = _remote_frees.load(std::memory_order_relaxed);
+		do
+		{
+			pSlot->next = static_cast<Slot*>(head);
+		} while (!_remote_frees.compare_exchange_weak(head, pSlot, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// A cheap check for the owner to make before paying for the exchange in takeRemoteFrees.
+	bool hasRemoteFrees() const
+	{
+		return _remote_frees.load(std::memory_order_relaxed) != nullptr;
+	}
+
+	// There is only one consumer, so taking the whole list at once can't suffer from ABA.
+	void* takeRemoteFrees()
+	{
+		return _remote_frees.exchange(nullptr, std::memory_order_acquire);
+	}
+
+private:
+	// Written by other threads, so it gets a cache line of its own.
+	alignas(64) std::atomic<void*> _remote_frees;
+};
+
+// The policies are base classes so that empty ones take up no space. MSVC only applies the empty
+// base optimisation to more than one base class when the class is marked with empty_bases.
+#ifdef _MSC_VER
+#define POOL_EMPTY_BASES __declspec(empty_bases)
+#else
+#define POOL_EMPTY_BASES
+#endif
 
 // The number of items is provided as a template parameter so that the whole pool can be created
 // from a single large allocation if being created dynamically.
-template<class type, size_t pool_size>
-class PoolAllocator
+template<class type, size_t pool_size, size_t slot_alignment = 0, class check_policy = DefaultPoolChecks, class free_list_policy = LifoFreeList, class telemetry_policy = NoPoolTelemetry, class remote_free_policy = NoRemoteFrees>
+class POOL_EMPTY_BASES PoolAllocator : public telemetry_policy, public remote_free_policy
 {
+	static_assert((slot_alignment & (slot_alignment - 1)) == 0, "slot_alignment must be a power of two");
+
 public:
 	// This typedef is for my own benefit and saves duplicate type declarations when defining
 	// the Deletor below.
-	typedef PoolAllocator<type, pool_size> pool_type;
+	typedef PoolAllocator<type, pool_size, slot_alignment, check_policy, free_list_policy, telemetry_policy, remote_free_policy> pool_type;
 
 	// A functor to wrap deleter functionality for a specific pool instance. This is used when
 	// creating shared_ptr/unique_ptr to route delete requests back to the correct pool.
@@ -43,43 +191,80 @@ public:
 
 	typedef std::unique_ptr<type, Deletor> unique_ptr;
 
-	PoolAllocator()
+	// A deletor for a pool that is known at compile time, e.g. a global or static pool. It has no
+	// members so a unique_ptr using it is the same size as a raw pointer, where Deletor doubles it.
+	// It mustn't be final, unique_ptr relies on deriving from it to optimise the storage away.
+	template<pool_type& pool>
+	class StaticDeletor
 	{
+	public:
+		void operator()(type* pMem) const
+		{
+			pool.destruct(pMem);
+		}
+	};
+
+	template<pool_type& pool>
+	using static_unique_ptr = std::unique_ptr<type, StaticDeletor<pool>>;
+
+	PoolAllocator() :
+		_next_untouched(0)
+	{
+		static_assert(policiesAddNoSize(), "Empty policies shouldn't add to the size of the pool");
+		// The occupancy bitmap is the only thing that needs to be cleared in full, and it's tiny
+		// compared to the pool itself.
+		memset(_occupied, 0, sizeof(_occupied));
 		reset();
 	}
 
 	void reset()
 	{
-		// To save us from having to search the pool for a free allocation, all the pool slots are
+		// To save us from having to search the pool for a free allocation, released slots are
 		// added to a linked list. We can then take the head item when we need a new allocation and
-		// push a new head item when we de-allocate.
+		// push a new head item when we de-allocate (or a new tail item, for FIFO). The address
+		// ordered policy searches the occupancy bitmap instead, starting from the lowest word that
+		// may have a free slot.
+		// Slots that have never been used aren't on the list. Instead they are handed out in order
+		// by bumping _next_untouched once the list is empty. That makes reset O(1) rather than
+		// having to visit every slot, and the pool's pages aren't touched until they're needed.
+		// Only the part of the occupancy bitmap covering slots that have been handed out needs
+		// clearing.
+		memset(_occupied, 0, ((_next_untouched + 63) / 64) * sizeof(uint64_t));
+		// Remote frees still waiting to be reclaimed are now free anyway.
+		this->takeRemoteFrees();
 		_allocation_count = 0;
 		_next_free = nullptr;
-		for (size_t i = 0; i < pool_size; i++)
-		{
-			_pool[i].next = _next_free;
-			_next_free = &_pool[i];
-		}
+		_free_tail = nullptr;
+		_first_free_word = 0;
+		_next_untouched = 0;
 	}
 
 	size_t getPoolSize() const { return pool_size; }
+	// The number of bytes each item takes up in the pool, including book keeping and padding.
+	static constexpr size_t getSlotSize() { return sizeof(PoolEntry); }
 	unsigned int getFreeCount() const { return (unsigned int)(pool_size - _allocation_count); }
 	unsigned int getAllocCount() const { return (unsigned int)_allocation_count; }
 
 	template <class... _Types>
 	type* construct(_Types&&... _Args)
 	{
-		if (_allocation_count == pool_size) throw std::bad_alloc();
+		if (this->hasRemoteFrees()) reclaimRemoteFrees();
+		if (_allocation_count == pool_size)
+		{
+			this->onFailedAllocation();
+			throw std::bad_alloc();
+		}
+		auto allocation = takeFreeEntry();
 		_allocation_count++;
-		auto allocation = _next_free;
-		_next_free = allocation->next;
 		// We set the next pointer to a statically allocated item specific to this pool to indicate
 		// that this slot is now in use. We verify this pointer when releasing an allocation so
 		// that we have a simple check that the pointer we're attempting to release is valid.
 		// We have to cast away the const as the marker object is created using constexpr which is
 		// required until C++17 which supports "static inline" for this type of scenario.
 		allocation->next = const_cast<PoolEntry*>(&ENTRY_IN_USE);
-		return new(allocation->mem) type(std::forward<_Types>(_Args)...);
+		type* pItem = new(allocation->mem) type(std::forward<_Types>(_Args)...);
+		this->onAllocate(1, _allocation_count);
+		return pItem;
 	}
 
 	void destruct(type* pMem)
@@ -88,9 +273,163 @@ public:
 		verifyEntryWithinPool(pEntry);
 		// As we constructed the item in the pool, it is also our responsibility to destruct them.
 		pMem->~type();
-		pEntry->next = _next_free;
-		_next_free = pEntry;
+		poison(pEntry);
+		pushFreeEntry(pEntry);
 		_allocation_count--;
+		this->onFree(1);
+	}
+
+	// Releases an item from a thread other than the one that owns the pool. Only available with the
+	// RemoteFrees policy. The item is destructed straight away, but its slot only becomes available
+	// again once the owning thread next constructs an item.
+	void destruct_remote(type* pMem)
+	{
+		PoolEntry* pEntry = getEntry(pMem);
+		// The owning thread may be changing the occupancy bitmap at the same time, so only the
+		// slot itself is checked here. The rest is checked when the owner reclaims the slot.
+		verifyEntryMarked(pEntry);
+		pMem->~type();
+		poison(pEntry);
+		this->pushRemoteFree(pEntry);
+	}
+
+	// Constructs count items in one operation, each from the same constructor arguments, and
+	// writes their addresses to ppItems. This is all or nothing, if there isn't room for every
+	// item then std::bad_alloc is thrown and nothing is allocated.
+	template <class... _Types>
+	void construct_n(type** ppItems, size_t count, const _Types&... _Args)
+	{
+		if (this->hasRemoteFrees()) reclaimRemoteFrees();
+		if (count > pool_size - _allocation_count)
+		{
+			this->onFailedAllocation();
+			throw std::bad_alloc();
+		}
+
+		// Reserve all of the slots in one go.
+		for (size_t i = 0; i < count; i++)
+		{
+			try
+			{
+				ppItems[i] = reinterpret_cast<type*>(takeFreeEntry()->mem);
+			}
+			catch (...)
+			{
+				// Only possible if a poisoned slot has been overwritten.
+				_allocation_count += i;
+				release(ppItems, i);
+				throw;
+			}
+		}
+		_allocation_count += count;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			PoolEntry* pEntry = getEntry(ppItems[i]);
+			pEntry->next = const_cast<PoolEntry*>(&ENTRY_IN_USE);
+			try
+			{
+				new(pEntry->mem) type(_Args...);
+			}
+			catch (...)
+			{
+				// Undo everything so that a failure leaves the pool as it was.
+				for (size_t j = 0; j < i; j++)
+					ppItems[j]->~type();
+				release(ppItems, count);
+				throw;
+			}
+		}
+		this->onAllocate(count, _allocation_count);
+	}
+
+	// Destructs count items in one operation. Every item is verified before anything is released
+	// so an invalid pointer leaves the pool untouched. Destructors are skipped entirely for
+	// trivially destructible types.
+	void destruct_n(type* const* ppItems, size_t count)
+	{
+		// Link the entries into a chain as we verify them. This also catches the same item being
+		// passed twice as its next pointer will no longer be the in-use marker.
+		PoolEntry* chain = nullptr;
+		for (size_t i = 0; i < count; i++)
+		{
+			PoolEntry* pEntry = getEntry(ppItems[i]);
+			try
+			{
+				verifyEntryWithinPool(pEntry);
+			}
+			catch (...)
+			{
+				// Put back the markers we've overwritten before reporting the problem.
+				while (chain != nullptr)
+				{
+					PoolEntry* next = chain->next;
+					chain->next = const_cast<PoolEntry*>(&ENTRY_IN_USE);
+					chain = next;
+				}
+				throw;
+			}
+			pEntry->next = chain;
+			chain = pEntry;
+		}
+
+		if (!std::is_trivially_destructible<type>::value)
+		{
+			for (size_t i = 0; i < count; i++)
+				ppItems[i]->~type();
+		}
+		if (check_policy::poison_freed)
+		{
+			for (size_t i = 0; i < count; i++)
+				poison(getEntry(ppItems[i]));
+		}
+
+		if (free_list_policy::order == FreeListOrder::LIFO)
+		{
+			for (size_t i = 0; i < count; i++)
+				markFree(getEntry(ppItems[i]) - _pool);
+			if (chain != nullptr)
+			{
+				// The first item verified is at the end of the chain.
+				getEntry(ppItems[0])->next = _next_free;
+				_next_free = chain;
+			}
+		}
+		else
+		{
+			// The other orders don't have a chain that can be spliced in one go.
+			for (size_t i = 0; i < count; i++)
+				pushFreeEntry(getEntry(ppItems[i]));
+		}
+		_allocation_count -= count;
+		this->onFree(count);
+	}
+
+	// Calls func(type&) for every live item in the pool in address order. The function must not
+	// construct or destruct items in this pool.
+	template <class Func>
+	void for_each_live(Func func)
+	{
+		// Remotely released items have already been destructed, so they mustn't be visited.
+		if (this->hasRemoteFrees()) reclaimRemoteFrees();
+		// Nothing beyond the untouched slots can be live.
+		size_t words = (_next_untouched + 63) / 64;
+		for (size_t word = 0; word < words; word++)
+		{
+			// A word of zero means 64 empty slots that we can skip in one go. Otherwise we jump
+			// straight to each set bit and then clear it.
+			for (uint64_t bits = _occupied[word]; bits != 0; bits &= bits - 1)
+			{
+				size_t index = word * 64 + countTrailingZeros(bits);
+				func(*reinterpret_cast<type*>(_pool[index].mem));
+			}
+		}
+	}
+
+	template <class Func>
+	void for_each_live(Func func) const
+	{
+		const_cast<pool_type*>(this)->for_each_live([&func](const type& item) { func(item); });
 	}
 
 	template <class... _Types>
@@ -107,40 +446,229 @@ public:
 		return unique_ptr(pItem, Deletor(this));
 	}
 
+	// Constructs an item from a pool with static storage duration and returns a pointer sized
+	// unique_ptr for it, e.g. decltype(s_pool)::make_static_unique<s_pool>(...).
+	template <pool_type& pool, class... _Types>
+	static static_unique_ptr<pool> make_static_unique(_Types&&... _Args)
+	{
+		type* pItem = pool.construct(std::forward<_Types>(_Args)...);
+		return static_unique_ptr<pool>(pItem);
+	}
+
 private:
-	struct PoolEntry
+	// The alignment of each slot is the largest of what the item needs, what the next pointer
+	// needs and what was asked for. As sizeof is always a multiple of alignof, aligning the struct
+	// also pads it so that the following slot starts on the same boundary.
+	static constexpr size_t ENTRY_ALIGNMENT =
+		alignof(type) > slot_alignment ?
+			(alignof(type) > alignof(void*) ? alignof(type) : alignof(void*)) :
+			(slot_alignment > alignof(void*) ? slot_alignment : alignof(void*));
+
+	struct alignas(ENTRY_ALIGNMENT) PoolEntry
 	{
 		PoolEntry* next;
 		// The memory for the item is stored inline within the PoolEntry.
 		// I allocated using a char array rather that type as there may not be a safe default
-		// constructor for the type.
-		char mem[sizeof(type)];
+		// constructor for the type. The char array has to be explicitly aligned for the type,
+		// otherwise it would immediately follow the pointer.
+		alignas(type) char mem[sizeof(type)];
 	};
 
+	// With empty policies the pool is standard layout, so the only way its first member isn't at
+	// the very start is if the policies have been given space of their own.
+	static constexpr bool policiesAddNoSize()
+	{
+		if constexpr (std::is_empty<telemetry_policy>::value && std::is_empty<remote_free_policy>::value)
+			return offsetof(pool_type, _allocation_count) == 0;
+		else
+			return true;
+	}
+
 	// A marker item we use to mark a slot once we've allocated it.
 	static constexpr PoolEntry ENTRY_IN_USE = PoolEntry();
 
+	// One bit per slot, rounded up to whole 64 bit words. There's always at least one word so that
+	// we don't end up with a zero sized array.
+	static constexpr size_t OCCUPANCY_WORDS = pool_size != 0 ? (pool_size + 63) / 64 : 1;
+
 	PoolEntry* getEntry(type* pMem)
 	{
-		// We use basic pointer arithmetic to get back to the start of the PoolEntry.
-		// If we added more items to the PoolEntry struct, we'd need to update this calculation.
+		// We use basic pointer arithmetic to get back to the start of the PoolEntry. The item may
+		// not immediately follow the next pointer if it needs a larger alignment, so we use the
+		// offset of mem rather than the size of the pointer.
 		auto raw = reinterpret_cast<char*>(pMem);
-		raw -= sizeof(PoolEntry*);
+		raw -= offsetof(PoolEntry, mem);
 		return reinterpret_cast<PoolEntry*>(raw);
 	}
 
-	void verifyEntryWithinPool(PoolEntry* pEntry)
+	// Takes a free slot and marks it as occupied. Slots that have never been used are only handed
+	// out once there are no released slots to reuse. The caller must have checked that the pool
+	// isn't full.
+	PoolEntry* takeFreeEntry()
+	{
+		PoolEntry* allocation;
+		if (free_list_policy::order == FreeListOrder::ADDRESS_ORDERED)
+		{
+			allocation = findLowestFreeEntry();
+			if (allocation == nullptr) allocation = &_pool[_next_untouched++];
+			else verifyPoison(allocation);
+		}
+		else if (_next_free == nullptr)
+		{
+			allocation = &_pool[_next_untouched++];
+		}
+		else
+		{
+			allocation = _next_free;
+			verifyPoison(allocation);
+			_next_free = allocation->next;
+			if (_next_free == nullptr) _free_tail = nullptr;
+		}
+		markOccupied(allocation - _pool);
+		return allocation;
+	}
+
+	// Marks a slot as free and makes it available to takeFreeEntry.
+	void pushFreeEntry(PoolEntry* pEntry)
+	{
+		size_t index = pEntry - _pool;
+		markFree(index);
+		switch (free_list_policy::order)
+		{
+		case FreeListOrder::LIFO:
+			pEntry->next = _next_free;
+			_next_free = pEntry;
+			break;
+
+		case FreeListOrder::FIFO:
+			pEntry->next = nullptr;
+			if (_free_tail != nullptr) _free_tail->next = pEntry;
+			else _next_free = pEntry;
+			_free_tail = pEntry;
+			break;
+
+		case FreeListOrder::ADDRESS_ORDERED:
+			// The slot isn't linked anywhere, the bitmap is all that's needed to find it again.
+			pEntry->next = nullptr;
+			if (index / 64 < _first_free_word) _first_free_word = index / 64;
+			break;
+		}
+	}
+
+	// Searches the occupancy bitmap for the lowest released slot, returning nullptr if there isn't
+	// one. Every word before _first_free_word is known to be full.
+	PoolEntry* findLowestFreeEntry()
+	{
+		size_t words = (_next_untouched + 63) / 64;
+		for (size_t word = _first_free_word; word < words; word++)
+		{
+			uint64_t bits = ~_occupied[word];
+			if (bits == 0) continue;
+			_first_free_word = word;
+			size_t index = word * 64 + countTrailingZeros(bits);
+			// Clear bits past _next_untouched are slots that have never been used.
+			if (index >= _next_untouched) break;
+			return &_pool[index];
+		}
+		return nullptr;
+	}
+
+	// Moves the slots released by other threads on to the free list. This is where the checks that
+	// destruct_remote can't make from another thread are made. Slots that fail them, such as ones
+	// from before the last reset, are left off the free list, and once every other slot has been
+	// reclaimed the problem is reported.
+	void reclaimRemoteFrees()
+	{
+		size_t count = 0;
+		bool invalid = false;
+		auto pEntry = static_cast<PoolEntry*>(this->takeRemoteFrees());
+		while (pEntry != nullptr)
+		{
+			PoolEntry* pNext = pEntry->next;
+			if (check_policy::check_in_use && !isHandedOut(pEntry - _pool))
+			{
+				invalid = true;
+			}
+			else
+			{
+				pushFreeEntry(pEntry);
+				count++;
+			}
+			pEntry = pNext;
+		}
+		_allocation_count -= count;
+		this->onFree(count);
+		if (invalid) throw std::invalid_argument("Allocation released remotely wasn't in use");
+	}
+
+	// Returns slots that were reserved by construct_n to the free list without destructing them.
+	// They're poisoned like any other released slot, whether or not an item was ever constructed in
+	// them, so that they pass the check when they're next allocated.
+	void release(type* const* ppItems, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			PoolEntry* pEntry = getEntry(ppItems[i]);
+			poison(pEntry);
+			pushFreeEntry(pEntry);
+		}
+		_allocation_count -= count;
+	}
+
+	void markOccupied(size_t index) { _occupied[index / 64] |= (uint64_t)1 << (index % 64); }
+	void markFree(size_t index) { _occupied[index / 64] &= ~((uint64_t)1 << (index % 64)); }
+	bool isOccupied(size_t index) const { return (_occupied[index / 64] & ((uint64_t)1 << (index % 64))) != 0; }
+	// Whether a slot has been handed out since the last reset and not released since.
+	bool isHandedOut(size_t index) const { return index < _next_untouched && isOccupied(index); }
+
+	// The checks that only look at the slot itself, so they're safe to make from any thread.
+	void verifyEntryMarked(PoolEntry* pEntry)
 	{
 		// First check that the pointer's address is within the address range of this pool.
-		if (pEntry < _pool || pEntry >= &_pool[pool_size]) throw std::invalid_argument("Allocation is not within this pool");
+		if (check_policy::check_range && (pEntry < _pool || pEntry >= &_pool[pool_size])) throw std::invalid_argument("Allocation is not within this pool");
 		// Then check that the entry was marked correctly. This guards against trying to release
 		// an already released allocation or passing an invaid pointer that is still within the pool's
 		// address range.
-		if (pEntry->next != &ENTRY_IN_USE) throw std::invalid_argument("Allocation already appears to have been destructed");
+		if (check_policy::check_in_use && pEntry->next != &ENTRY_IN_USE) throw std::invalid_argument("Allocation already appears to have been destructed");
+	}
+
+	void verifyEntryWithinPool(PoolEntry* pEntry)
+	{
+		verifyEntryMarked(pEntry);
+		// reset doesn't clear the markers, so a slot from before the last reset still has one.
+		// Only slots handed out since then and still marked as occupied can be in use.
+		if (check_policy::check_in_use && !isHandedOut(pEntry - _pool)) throw std::invalid_argument("Allocation already appears to have been destructed");
+	}
+
+	void poison(PoolEntry* pEntry)
+	{
+		if (check_policy::poison_freed) memset(pEntry->mem, check_policy::POISON, sizeof(type));
+	}
+
+	// Checks that a slot coming off the free list still holds the poison it was filled with when it
+	// was released. If not, something wrote to it after it was released.
+	void verifyPoison(PoolEntry* pEntry)
+	{
+		if (!check_policy::poison_freed) return;
+		for (size_t i = 0; i < sizeof(type); i++)
+			if ((unsigned char)pEntry->mem[i] != check_policy::POISON) throw std::logic_error("Released allocation was modified after it was destructed");
 	}
 
 	size_t _allocation_count;
 	PoolEntry* _next_free;
+	// Only used by the FIFO order.
+	PoolEntry* _free_tail;
+	// Only used by the address ordered order.
+	size_t _first_free_word;
+	// Index of the first slot that has never been allocated since the last reset.
+	size_t _next_untouched;
+	// Bit n is set when slot n is in use.
+	uint64_t _occupied[OCCUPANCY_WORDS];
 	// The memory for the pool is declared inline with the rest of this class.
 	PoolEntry _pool[pool_size];
 };
+
+// Out of class definition for the in-use marker. This is only needed until C++17 where static
+// constexpr members are implicitly inline, but some compilers will fail to link without it.
+template<class type, size_t pool_size, size_t slot_alignment, class check_policy, class free_list_policy, class telemetry_policy, class remote_free_policy>
+constexpr typename PoolAllocator<type, pool_size, slot_alignment, check_policy, free_list_policy, telemetry_policy, remote_free_policy>::PoolEntry PoolAllocator<type, pool_size, slot_alignment, check_policy, free_list_policy, telemetry_policy, remote_free_policy>::ENTRY_IN_USE;
\ No newline at end of file
@@ -0,0 +1,100 @@
+/*
+ * An adapter that lets node based standard containers, such as std::list, std::map and
+ * std::unordered_map, allocate their nodes from a PoolAllocator.
+ *
+ * A container never allocates the value_type it's given. It rebinds the allocator to its own
+ * internal node type and allocates those instead, and we can't name the node type in advance. So
+ * rather than the container owning a pool, each rebound node type gets one static pool, created on
+ * first use, that is shared by every container using the same allocator type. The pool holds a
+ * fixed pool_size nodes between all of those containers, and once they are all in use the next
+ * insert into any of them throws std::bad_alloc. Containers that shouldn't share pools can be given
+ * different tag types.
+ *
+ * Only single objects come from the pools. Arrays, such as the bucket array of an unordered_map,
+ * still go to the global heap, but they are allocated rarely compared to nodes.
+ *
+ * Like PoolAllocator itself, this isn't thread safe. All containers sharing the pools must be used
+ * from the same thread.
+ */
+#pragma once
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include "PoolAllocator.h"
+
+template<class T, size_t pool_size, class tag = void>
+class PoolStlAllocator
+{
+public:
+	typedef T value_type;
+	// Every instance uses the same pools so they are all interchangeable.
+	typedef std::true_type is_always_equal;
+	typedef std::true_type propagate_on_container_move_assignment;
+
+	// pool_size isn't a type parameter, so the default rebind in std::allocator_traits can't be used.
+	template<class U>
+	struct rebind
+	{
+		typedef PoolStlAllocator<U, pool_size, tag> other;
+	};
+
+	PoolStlAllocator() noexcept {}
+
+	template<class U>
+	PoolStlAllocator(const PoolStlAllocator<U, pool_size, tag>&) noexcept {}
+
+	T* allocate(size_t count)
+	{
+		if (count != 1) return allocateArray(count);
+		return reinterpret_cast<T*>(pool().construct());
+	}
+
+	void deallocate(T* pMem, size_t count)
+	{
+		if (count != 1) deallocateArray(pMem);
+		else pool().destruct(reinterpret_cast<Storage*>(pMem));
+	}
+
+	template<class U>
+	bool operator==(const PoolStlAllocator<U, pool_size, tag>&) const noexcept { return true; }
+	template<class U>
+	bool operator!=(const PoolStlAllocator<U, pool_size, tag>&) const noexcept { return false; }
+
+private:
+	// Plain operator new only guarantees __STDCPP_DEFAULT_NEW_ALIGNMENT__, so over-aligned types
+	// need the aligned forms, and deallocate must use the same form allocate did.
+	static constexpr bool OVER_ALIGNED = alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+	static T* allocateArray(size_t count)
+	{
+		if (count > SIZE_MAX / sizeof(T)) throw std::bad_array_new_length();
+		if constexpr (OVER_ALIGNED)
+			return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignof(T))));
+		else
+			return static_cast<T*>(::operator new(count * sizeof(T)));
+	}
+
+	static void deallocateArray(T* pMem)
+	{
+		if constexpr (OVER_ALIGNED)
+			::operator delete(pMem, std::align_val_t(alignof(T)));
+		else
+			::operator delete(pMem);
+	}
+
+	// Raw storage for a T. The pool constructs these, which is a no-op, and the container then
+	// constructs the T in place.
+	struct Storage
+	{
+		alignas(T) char mem[sizeof(T)];
+	};
+
+	typedef PoolAllocator<Storage, pool_size> pool_type;
+
+	static pool_type& pool()
+	{
+		static pool_type s_pool;
+		return s_pool;
+	}
+};
@@ -0,0 +1,115 @@
+/*
+ * Optional usage counters for pools, selected with a pool's telemetry_policy parameter.
+ *
+ * getFreeCount and getAllocCount only say what the pool looks like right now. To size a pool from
+ * real usage we also want to know the most it has ever held, how many allocations it has served
+ * and how many it has had to refuse. PoolTelemetry keeps those counts. Every counter only has a
+ * single writer, the thread using the pool, so they are updated with relaxed loads and stores
+ * rather than atomic read-modify-writes. That costs the same as plain integers on the hot path
+ * but still lets a monitoring thread read them safely.
+ *
+ * NoPoolTelemetry is the default. It's an empty class with empty inline functions, so it compiles
+ * away to nothing. As an empty base class it adds nothing to the size of the pool either, which
+ * on MSVC relies on the pool being marked with POOL_EMPTY_BASES.
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+
+// A snapshot of a pool's counters. Rates are worked out by comparing two snapshots.
+struct PoolStats
+{
+	std::chrono::steady_clock::time_point time;
+	// The largest number of items that have been allocated at once.
+	size_t high_water_mark;
+	uint64_t allocations;
+	uint64_t frees;
+	// Allocations that failed because the pool was full.
+	uint64_t failed_allocations;
+
+	// Allocations per second between an earlier snapshot and this one.
+	double allocationRateSince(const PoolStats& earlier) const
+	{
+		return rate(allocations - earlier.allocations, earlier);
+	}
+
+	// Frees per second between an earlier snapshot and this one.
+	double freeRateSince(const PoolStats& earlier) const
+	{
+		return rate(frees - earlier.frees, earlier);
+	}
+
+private:
+	double rate(uint64_t count, const PoolStats& earlier) const
+	{
+		double seconds = std::chrono::duration<double>(time - earlier.time).count();
+		return seconds > 0 ? count / seconds : 0;
+	}
+};
+
+class NoPoolTelemetry
+{
+protected:
+	void onAllocate(size_t, size_t) {}
+	void onFree(size_t) {}
+	void onFailedAllocation() {}
+};
+
+class PoolTelemetry
+{
+public:
+	PoolTelemetry() :
+		_high_water_mark(0),
+		_allocations(0),
+		_frees(0),
+		_failed_allocations(0)
+	{
+
+	}
+
+	// Safe to call from any thread.
+	PoolStats getStats() const
+	{
+		PoolStats stats;
+		stats.time = std::chrono::steady_clock::now();
+		stats.high_water_mark = _high_water_mark.load(std::memory_order_relaxed);
+		stats.allocations = _allocations.load(std::memory_order_relaxed);
+		stats.frees = _frees.load(std::memory_order_relaxed);
+		stats.failed_allocations = _failed_allocations.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+protected:
+	// count items were allocated, leaving allocated items live in total.
+	void onAllocate(size_t count, size_t allocated)
+	{
+		increment(_allocations, count);
+		if (allocated > _high_water_mark.load(std::memory_order_relaxed)) _high_water_mark.store(allocated, std::memory_order_relaxed);
+	}
+
+	void onFree(size_t count)
+	{
+		increment(_frees, count);
+	}
+
+	void onFailedAllocation()
+	{
+		increment(_failed_allocations, 1);
+	}
+
+private:
+	// Only the owning thread writes, so a separate load and store is enough and avoids the cost of
+	// a locked instruction.
+	template<class T>
+	static void increment(std::atomic<T>& counter, size_t count)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+	}
+
+	std::atomic<size_t> _high_water_mark;
+	std::atomic<uint64_t> _allocations;
+	std::atomic<uint64_t> _frees;
+	std::atomic<uint64_t> _failed_allocations;
+};
@@ -0,0 +1,106 @@
+/*
+ * A pool for items that are going to be managed by std::shared_ptr.
+ *
+ * PoolAllocator::make_shared wraps a pooled item in a shared_ptr with a custom deleter. That works,
+ * but shared_ptr then has to allocate its control block (the reference counts and the deleter)
+ * from the global heap, so every pooled shared object still costs a heap allocation and the
+ * reference counts end up on a different cache line to the object.
+ *
+ * std::allocate_shared solves this by allocating the control block and the object together as a
+ * single block from an allocator we supply. The catch is that the block's type is an internal
+ * detail of the standard library, so we can't name it when declaring the pool. Instead the pool's
+ * slots are sized to hold the item plus a generous allowance for the control block, and the
+ * allocator handed to allocate_shared checks at compile time that the library's block really does
+ * fit.
+ */
+#pragma once
+#include <memory>
+#include <new>
+#include <stddef.h>
+#include "PoolAllocator.h"
+
+template<class type, size_t pool_size>
+class SharedPoolAllocator
+{
+	// All of the standard libraries we care about put a vtable pointer and two 32 bit counts ahead of
+	// the object, along with a copy of the allocator (a single pointer here). For over-aligned types
+	// the counts and the allocator can each end up padded out to the item's alignment.
+	static constexpr size_t BLOCK_ALIGNMENT = alignof(type) > alignof(void*) ? alignof(type) : alignof(void*);
+	static constexpr size_t HEADER_SIZE = (2 * sizeof(void*) + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+	static constexpr size_t ITEM_SIZE = (sizeof(type) + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+	static constexpr size_t BLOCK_SIZE = 2 * HEADER_SIZE + ITEM_SIZE;
+
+	// Raw storage for a control block and item.
+	struct Block
+	{
+		alignas(BLOCK_ALIGNMENT) char mem[BLOCK_SIZE];
+	};
+
+	typedef PoolAllocator<Block, pool_size> block_pool_type;
+
+public:
+	typedef SharedPoolAllocator<type, pool_size> pool_type;
+
+	// A minimal standard allocator that hands out blocks from the pool. allocate_shared rebinds it
+	// to its own internal block type, which is why it is a template.
+	template<class T>
+	class BlockAllocator
+	{
+	public:
+		typedef T value_type;
+
+		template<class U>
+		struct rebind
+		{
+			typedef BlockAllocator<U> other;
+		};
+
+		BlockAllocator(block_pool_type* pPool) noexcept :
+			_pPool(pPool) {}
+
+		template<class U>
+		BlockAllocator(const BlockAllocator<U>& other) noexcept :
+			_pPool(other._pPool) {}
+
+		T* allocate(size_t count)
+		{
+			static_assert(sizeof(T) <= sizeof(Block), "The standard library's shared_ptr control block doesn't fit in a pool slot");
+			static_assert(alignof(T) <= alignof(Block), "The standard library's shared_ptr control block needs a larger alignment than a pool slot");
+			// Only single objects are allocated from the pool.
+			if (count != 1) throw std::bad_alloc();
+			return reinterpret_cast<T*>(_pPool->construct());
+		}
+
+		void deallocate(T* pMem, size_t)
+		{
+			_pPool->destruct(reinterpret_cast<Block*>(pMem));
+		}
+
+		template<class U>
+		bool operator==(const BlockAllocator<U>& other) const { return _pPool == other._pPool; }
+		template<class U>
+		bool operator!=(const BlockAllocator<U>& other) const { return _pPool != other._pPool; }
+
+	private:
+		template<class U> friend class BlockAllocator;
+		block_pool_type* _pPool;
+	};
+
+	size_t getPoolSize() const { return pool_size; }
+	unsigned int getFreeCount() const { return _blocks.getFreeCount(); }
+	unsigned int getAllocCount() const { return _blocks.getAllocCount(); }
+	// The number of bytes each item takes up in the pool, including its control block.
+	static constexpr size_t getSlotSize() { return block_pool_type::getSlotSize(); }
+
+	// Constructs an item and its shared_ptr control block in a single pool slot. Note that the
+	// slot isn't released until the last weak_ptr has gone as well as the last shared_ptr, as the
+	// weak_ptrs still need the control block.
+	template <class... _Types>
+	std::shared_ptr<type> make_shared(_Types&&... _Args)
+	{
+		return std::allocate_shared<type>(BlockAllocator<type>(&_blocks), std::forward<_Types>(_Args)...);
+	}
+
+private:
+	block_pool_type _blocks;
+};
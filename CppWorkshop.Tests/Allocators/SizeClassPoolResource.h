@@ -0,0 +1,189 @@
+/*
+ * A general purpose small object allocator, exposed as a std::pmr::memory_resource so that any pmr
+ * container can use it.
+ *
+ * The pool allocators elsewhere in this directory each handle a single type. This resource instead
+ * keeps one pool per size class, 8, 16, 32 and so on up to 1024 bytes, and serves each request from
+ * the smallest class that fits. Every block in a class is the same size so, just like PoolAllocator,
+ * allocation and release are a free list pop and push. Unlike PoolAllocator, the free list link is
+ * stored in the free block itself so there is no per block overhead beyond the rounding up to the
+ * size class. The blocks are carved out of large chunks requested from an upstream resource, and
+ * requests larger than 1024 bytes, or that need more than the alignment of std::max_align_t, are
+ * passed straight through to the upstream resource.
+ *
+ * pmr passes the size of an allocation back in when it's released, so we can find the size class
+ * again without storing it anywhere.
+ *
+ * As with std::pmr::unsynchronized_pool_resource, this isn't thread safe.
+ */
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <stdint.h>
+
+class SizeClassPoolResource : public std::pmr::memory_resource
+{
+public:
+	static constexpr size_t MIN_BLOCK_SIZE = 8;
+	static constexpr size_t MAX_BLOCK_SIZE = 1024;
+	// 8, 16, 32, 64, 128, 256, 512 and 1024 bytes.
+	static constexpr size_t SIZE_CLASS_COUNT = 8;
+
+	// chunk_size is the number of bytes requested from upstream each time a size class runs out of
+	// blocks.
+	explicit SizeClassPoolResource(std::pmr::memory_resource* pUpstream = std::pmr::get_default_resource(), size_t chunk_size = 64 * 1024) :
+		_pUpstream(pUpstream),
+		_chunk_size(chunk_size < sizeof(Chunk) + MAX_BLOCK_SIZE ? sizeof(Chunk) + MAX_BLOCK_SIZE : chunk_size),
+		_chunks(nullptr),
+		_classes()
+	{
+
+	}
+
+	SizeClassPoolResource(const SizeClassPoolResource&) = delete;
+	SizeClassPoolResource& operator=(const SizeClassPoolResource&) = delete;
+
+	~SizeClassPoolResource()
+	{
+		release();
+	}
+
+	std::pmr::memory_resource* upstream_resource() const { return _pUpstream; }
+
+	// Returns every chunk to the upstream resource, whether or not its blocks have been released.
+	// Large allocations that were passed through to upstream are not affected.
+	void release()
+	{
+		while (_chunks != nullptr)
+		{
+			Chunk* pChunk = _chunks;
+			_chunks = pChunk->next;
+			_pUpstream->deallocate(pChunk, _chunk_size, alignof(std::max_align_t));
+		}
+		_classes = {};
+	}
+
+	// The size of the block that would be used for an allocation of the given size, or 0 if it
+	// would be passed upstream.
+	static size_t getBlockSize(size_t bytes, size_t alignment = alignof(std::max_align_t))
+	{
+		if (!isPooled(bytes, alignment)) return 0;
+		return MIN_BLOCK_SIZE << SIZE_CLASS_TABLE[getTableIndex(bytes, alignment)];
+	}
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		if (!isPooled(bytes, alignment)) return _pUpstream->allocate(bytes, alignment);
+
+		unsigned int sizeClass = SIZE_CLASS_TABLE[getTableIndex(bytes, alignment)];
+		SizeClass& pool = _classes[sizeClass];
+		if (pool.next_free != nullptr)
+		{
+			FreeBlock* pBlock = pool.next_free;
+			pool.next_free = pBlock->next;
+			return pBlock;
+		}
+
+		// As with PoolAllocator, blocks that have never been used are handed out by bumping a
+		// pointer through the current chunk rather than being added to the free list up front.
+		size_t blockSize = MIN_BLOCK_SIZE << sizeClass;
+		if (pool.untouched == pool.end) addChunk(pool, blockSize);
+		void* pBlock = pool.untouched;
+		pool.untouched += blockSize;
+		return pBlock;
+	}
+
+	void do_deallocate(void* pMem, size_t bytes, size_t alignment) override
+	{
+		if (!isPooled(bytes, alignment))
+		{
+			_pUpstream->deallocate(pMem, bytes, alignment);
+			return;
+		}
+
+		SizeClass& pool = _classes[SIZE_CLASS_TABLE[getTableIndex(bytes, alignment)]];
+		FreeBlock* pBlock = static_cast<FreeBlock*>(pMem);
+		pBlock->next = pool.next_free;
+		pool.next_free = pBlock;
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+private:
+	// Released blocks hold the link to the next free block in their own memory.
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	// Header at the start of every chunk requested from upstream. It's padded so that the blocks
+	// that follow keep the chunk's alignment.
+	struct alignas(std::max_align_t) Chunk
+	{
+		Chunk* next;
+	};
+
+	struct SizeClass
+	{
+		FreeBlock* next_free;
+		// The unused part of the most recent chunk.
+		char* untouched;
+		char* end;
+	};
+
+	// Maps (size + 7) / 8 to a size class, rounding up to the next power of two. Requests are looked
+	// up with one table read rather than working out the logarithm each time.
+	static constexpr std::array<uint8_t, MAX_BLOCK_SIZE / MIN_BLOCK_SIZE + 1> buildSizeClassTable()
+	{
+		std::array<uint8_t, MAX_BLOCK_SIZE / MIN_BLOCK_SIZE + 1> table = {};
+		uint8_t sizeClass = 0;
+		for (size_t i = 1; i < table.size(); i++)
+		{
+			if (i * MIN_BLOCK_SIZE > (MIN_BLOCK_SIZE << sizeClass)) sizeClass++;
+			table[i] = sizeClass;
+		}
+		return table;
+	}
+
+	static const std::array<uint8_t, MAX_BLOCK_SIZE / MIN_BLOCK_SIZE + 1> SIZE_CLASS_TABLE;
+
+	static bool isPooled(size_t bytes, size_t alignment)
+	{
+		return bytes <= MAX_BLOCK_SIZE && alignment <= alignof(std::max_align_t);
+	}
+
+	// Blocks are aligned to the smaller of their size and max_align_t, so a request that needs a
+	// larger alignment than its size is served from a bigger size class.
+	static size_t getTableIndex(size_t bytes, size_t alignment)
+	{
+		size_t size = bytes > alignment ? bytes : alignment;
+		return (size + MIN_BLOCK_SIZE - 1) / MIN_BLOCK_SIZE;
+	}
+
+	void addChunk(SizeClass& pool, size_t blockSize)
+	{
+		auto pChunk = static_cast<Chunk*>(_pUpstream->allocate(_chunk_size, alignof(std::max_align_t)));
+		pChunk->next = _chunks;
+		_chunks = pChunk;
+
+		// Any space at the end of the chunk that's too small for a whole block is wasted.
+		char* pStart = reinterpret_cast<char*>(pChunk + 1);
+		size_t blocks = (_chunk_size - sizeof(Chunk)) / blockSize;
+		pool.untouched = pStart;
+		pool.end = pStart + blocks * blockSize;
+	}
+
+	std::pmr::memory_resource* const _pUpstream;
+	const size_t _chunk_size;
+	// Every chunk requested from upstream, across all size classes.
+	Chunk* _chunks;
+	std::array<SizeClass, SIZE_CLASS_COUNT> _classes;
+};
+
+// Defined outside the class as buildSizeClassTable can't be called until the class is complete.
+inline const std::array<uint8_t, SizeClassPoolResource::MAX_BLOCK_SIZE / SizeClassPoolResource::MIN_BLOCK_SIZE + 1> SizeClassPoolResource::SIZE_CLASS_TABLE = SizeClassPoolResource::buildSizeClassTable();
@@ -0,0 +1,99 @@
+/*
+ * Replacements for the global operator new and delete that route every allocation made with new
+ * through a TrackingAllocator counting towards GlobalTrackingCounters. Nothing is replaced unless
+ * TRACK_GLOBAL_NEW is defined, see TrackedGlobalNew.h.
+ */
+#include "TrackedGlobalNew.h"
+
+#ifdef TRACK_GLOBAL_NEW
+#include <new>
+#include <stdint.h>
+
+namespace
+{
+	// TrackingAllocator with GlobalTrackingCounters has no state of its own, so a new one can be
+	// created for every call. Plain new must return memory aligned to
+	// __STDCPP_DEFAULT_NEW_ALIGNMENT__, so that's the alignment it's given.
+	typedef TrackingAllocator<uint8_t, __STDCPP_DEFAULT_NEW_ALIGNMENT__, GlobalTrackingCounters> GlobalAllocator;
+
+	// Giving TrackingAllocator a larger alignment would pad its size header out to the full
+	// alignment, so a 64KB aligned new would spend 64KB on an 8 byte size. Instead the block is
+	// allocated with the default alignment and enough extra space to align the pointer within it.
+	// The distance back to the start of the block is kept in an 8 byte slot just before the
+	// aligned pointer, and the block's own header still holds the size.
+	void* allocateBlock(size_t size, size_t alignment)
+	{
+		if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) return GlobalAllocator().allocate(size);
+
+		const size_t extra = sizeof(uint64_t) + alignment - 1;
+		if (size > SIZE_MAX - extra) throw std::bad_alloc();
+		uint8_t* pBlock = GlobalAllocator().allocate(size + extra);
+		uintptr_t aligned = ((uintptr_t)pBlock + sizeof(uint64_t) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		reinterpret_cast<uint64_t*>(aligned)[-1] = aligned - (uintptr_t)pBlock;
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	void deallocate(void* pMem, size_t alignment)
+	{
+		if (pMem == nullptr) return;
+		uint8_t* pBlock = static_cast<uint8_t*>(pMem);
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) pBlock -= static_cast<uint64_t*>(pMem)[-1];
+		GlobalAllocator().deallocate(pBlock);
+	}
+
+	void* allocate(size_t size, size_t alignment)
+	{
+		// As the standard operator new does, keep calling the new handler until it either frees
+		// enough memory or gives up.
+		for (;;)
+		{
+			try
+			{
+				return allocateBlock(size, alignment);
+			}
+			catch (const std::bad_alloc&)
+			{
+				std::new_handler handler = std::get_new_handler();
+				if (handler == nullptr) throw;
+				handler();
+			}
+		}
+	}
+
+	void* allocateNoThrow(size_t size, size_t alignment) noexcept
+	{
+		try
+		{
+			return allocate(size, alignment);
+		}
+		catch (...)
+		{
+			return nullptr;
+		}
+	}
+}
+
+void* operator new(size_t size) { return allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new[](size_t size) { return allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocateNoThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocateNoThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocate(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocate(size, (size_t)alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateNoThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateNoThrow(size, (size_t)alignment); }
+
+// The size passed to sized delete isn't needed, the allocation's header already has it.
+void operator delete(void* pMem) noexcept { deallocate(pMem, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete[](void* pMem) noexcept { deallocate(pMem, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete(void* pMem, const std::nothrow_t&) noexcept { deallocate(pMem, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete[](void* pMem, const std::nothrow_t&) noexcept { deallocate(pMem, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete(void* pMem, size_t) noexcept { deallocate(pMem, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete[](void* pMem, size_t) noexcept { deallocate(pMem, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete(void* pMem, std::align_val_t alignment) noexcept { deallocate(pMem, (size_t)alignment); }
+void operator delete[](void* pMem, std::align_val_t alignment) noexcept { deallocate(pMem, (size_t)alignment); }
+void operator delete(void* pMem, size_t, std::align_val_t alignment) noexcept { deallocate(pMem, (size_t)alignment); }
+void operator delete[](void* pMem, size_t, std::align_val_t alignment) noexcept { deallocate(pMem, (size_t)alignment); }
+void operator delete(void* pMem, std::align_val_t alignment, const std::nothrow_t&) noexcept { deallocate(pMem, (size_t)alignment); }
+void operator delete[](void* pMem, std::align_val_t alignment, const std::nothrow_t&) noexcept { deallocate(pMem, (size_t)alignment); }
+
+#endif
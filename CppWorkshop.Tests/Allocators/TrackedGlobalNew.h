@@ -0,0 +1,93 @@
+/*
+ * Process wide allocation tracking.
+ *
+ * TrackedVector2 shows how a class can route its own allocations through a TrackingAllocator, but
+ * that only ever sees the classes that opt in. Building with TRACK_GLOBAL_NEW defined and
+ * TrackedGlobalNew.cpp compiled into the program replaces the global operator new and delete,
+ * including the sized, aligned and nothrow forms, so that every allocation made with new goes
+ * through a TrackingAllocator instead. They all count towards GlobalTrackingCounters, which gives
+ * allocation counts and bytes for the whole process. Comparing the counts before and after a piece
+ * of code shows how much it allocates.
+ *
+ * The counts are sharded in the same way as ShardedTrackingCounters so that threads allocating at
+ * the same time don't fight over them. Memory allocated with malloc directly isn't counted.
+ */
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "TrackingAllocator.h"
+
+// Counts shared by every TrackingAllocator that uses this as its counter_policy, and by the global
+// operator new and delete when TRACK_GLOBAL_NEW is defined.
+class GlobalTrackingCounters
+{
+public:
+#ifdef TRACK_GLOBAL_NEW
+	static constexpr bool TRACKS_GLOBAL_NEW = true;
+#else
+	static constexpr bool TRACKS_GLOBAL_NEW = false;
+#endif
+
+	struct Counts
+	{
+		// Allocations that haven't been released yet, and the memory they're using.
+		uint64_t liveAllocations;
+		uint64_t liveBytes;
+		// Every allocation made since the program started, and their combined size.
+		uint64_t totalAllocations;
+		uint64_t totalBytes;
+	};
+
+	static Counts getCounts()
+	{
+		int64_t liveAllocations = 0, liveBytes = 0, totalAllocations = 0, totalBytes = 0;
+		for (const Shard& shard : s_shards)
+		{
+			liveAllocations += shard.liveAllocations.load(std::memory_order_relaxed);
+			liveBytes += shard.liveBytes.load(std::memory_order_relaxed);
+			totalAllocations += shard.totalAllocations.load(std::memory_order_relaxed);
+			totalBytes += shard.totalBytes.load(std::memory_order_relaxed);
+		}
+		// As with ShardedTrackingCounters, a read while other threads are allocating can briefly
+		// see a release without its allocation.
+		return { clamp(liveAllocations), clamp(liveBytes), (uint64_t)totalAllocations, (uint64_t)totalBytes };
+	}
+
+	unsigned int getNumAllocations() const { return (unsigned int)getCounts().liveAllocations; }
+	size_t getTotalAllocationsSize() const { return (size_t)getCounts().liveBytes; }
+
+protected:
+	void onAllocate(size_t size)
+	{
+		Shard& shard = s_shards[ShardedTrackingCounters::getShardIndex()];
+		shard.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+		shard.liveBytes.fetch_add((int64_t)size, std::memory_order_relaxed);
+		shard.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+		shard.totalBytes.fetch_add((int64_t)size, std::memory_order_relaxed);
+	}
+
+	void onDeallocate(size_t size)
+	{
+		Shard& shard = s_shards[ShardedTrackingCounters::getShardIndex()];
+		shard.liveBytes.fetch_sub((int64_t)size, std::memory_order_relaxed);
+		shard.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+private:
+	static uint64_t clamp(int64_t value) { return value > 0 ? (uint64_t)value : 0; }
+
+	struct alignas(64) Shard
+	{
+		constexpr Shard() : liveAllocations(0), liveBytes(0), totalAllocations(0), totalBytes(0) {}
+
+		std::atomic<int64_t> liveAllocations;
+		std::atomic<int64_t> liveBytes;
+		std::atomic<int64_t> totalAllocations;
+		std::atomic<int64_t> totalBytes;
+	};
+
+	// Constant initialised, so it's ready for operator new calls made before main, during the
+	// dynamic initialisation of other globals.
+	inline static Shard s_shards[ShardedTrackingCounters::SHARD_COUNT];
+};
@@ -1,14 +1,17 @@
 #pragma once
+#include <atomic>
+#include <cstddef>
 #include <malloc.h>
 #include <new>
+#include <stdlib.h>
+#include <stdint.h>
 
-// An example allocator that uses malloc/free under the hood, but tracks the allocations so that
-// we can query for total number of allocations and total size of allocations.
-template<typename T = uint8_t>
-class TrackingAllocator
+// Counts for a TrackingAllocator that's only used from one thread at a time. This is the default
+// as it's the cheapest.
+class TrackingCounters
 {
 public:
-	TrackingAllocator() :
+	TrackingCounters() :
 		_numAllocations(0),
 		_totalAllocationsSize(0)
 	{
@@ -18,37 +21,244 @@ public:
 	unsigned int getNumAllocations() const { return _numAllocations; }
 	size_t getTotalAllocationsSize() const { return _totalAllocationsSize; }
 
+protected:
+	void onAllocate(size_t size)
+	{
+		_numAllocations++;
+		_totalAllocationsSize += size;
+	}
+
+	void onDeallocate(size_t size)
+	{
+		_totalAllocationsSize -= size;
+		_numAllocations--;
+	}
+
+private:
+	unsigned int _numAllocations;
+	size_t _totalAllocationsSize;
+};
+
+// Counts for a TrackingAllocator that's shared between threads.
+//
+// A single pair of atomic counters would give the right numbers, but every allocate and deallocate
+// on every thread would then write to the same cache line, and bouncing it between cores costs far
+// more than the counting itself. Instead the counts are split into shards, each on its own cache
+// line, and each thread only ever updates one of them. Reading the totals sums all of the shards,
+// which is slower, but reads are rare compared to allocations.
+//
+// An allocation can be freed by a different thread to the one that made it, so an individual shard
+// can go negative. Only the sum is meaningful. The shards are read one at a time, so a read while
+// other threads are allocating is only approximate. It can see a release counted on one shard
+// without the allocation counted on another, so the sum is clamped at zero rather than wrapping
+// around. Once the other threads have stopped, the totals are exact.
+class ShardedTrackingCounters
+{
+public:
+	// More shards than there are likely to be threads allocating at once. Any extra threads share
+	// shards, which is still correct, just a little slower.
+	static constexpr unsigned int SHARD_COUNT = 16;
+
+	unsigned int getNumAllocations() const
+	{
+		int64_t total = 0;
+		for (const Shard& shard : _shards)
+			total += shard.numAllocations.load(std::memory_order_relaxed);
+		return total > 0 ? (unsigned int)total : 0;
+	}
+
+	size_t getTotalAllocationsSize() const
+	{
+		int64_t total = 0;
+		for (const Shard& shard : _shards)
+			total += shard.totalAllocationsSize.load(std::memory_order_relaxed);
+		return total > 0 ? (size_t)total : 0;
+	}
+
+	// Threads are given shards round robin the first time they allocate from any sharded
+	// allocator, and keep them for their lifetime.
+	static unsigned int getShardIndex()
+	{
+		static std::atomic<unsigned int> s_nextShard(0);
+		static thread_local unsigned int s_shard = s_nextShard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+		return s_shard;
+	}
+
+protected:
+	void onAllocate(size_t size)
+	{
+		Shard& shard = _shards[getShardIndex()];
+		shard.numAllocations.fetch_add(1, std::memory_order_relaxed);
+		shard.totalAllocationsSize.fetch_add((int64_t)size, std::memory_order_relaxed);
+	}
+
+	void onDeallocate(size_t size)
+	{
+		Shard& shard = _shards[getShardIndex()];
+		shard.totalAllocationsSize.fetch_sub((int64_t)size, std::memory_order_relaxed);
+		shard.numAllocations.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+private:
+	struct alignas(64) Shard
+	{
+		constexpr Shard() : numAllocations(0), totalAllocationsSize(0) {}
+
+		std::atomic<int64_t> numAllocations;
+		std::atomic<int64_t> totalAllocationsSize;
+	};
+
+	Shard _shards[SHARD_COUNT];
+};
+
+// The default sampling_policy for TrackingAllocator. It's an empty class with empty inline
+// functions, so it compiles away to nothing. See HeapSampler.h for the sampling profiler.
+class NoHeapSampling
+{
+public:
+	static constexpr bool SAMPLING = false;
+
+protected:
+	bool countSampleBytes(size_t) { return false; }
+	bool recordSample(void*, size_t) { return false; }
+	void releaseSample(void*) {}
+};
+
+// How TrackingAllocator finds the size of an allocation again when it's released.
+//  - SIZE_HEADER: the size is stored in a header in front of each allocation. This is the default
+//    and works with any heap, but the header makes every allocation bigger, which can push a small
+//    one into the heap's next size class.
+//  - USABLE_SIZE: there's no header, the heap is asked how big the allocation is instead, using
+//    malloc_usable_size on Linux and _msize on Windows. The size tracked is then what the heap
+//    actually set aside for the allocation, including any rounding up, rather than what was asked
+//    for.
+enum class TrackingMode
+{
+	SIZE_HEADER,
+	USABLE_SIZE,
+};
+
+// An example allocator that uses malloc/free under the hood, but tracks the allocations so that
+// we can query for total number of allocations and total size of allocations.
+//
+// By default the size of each allocation is kept in a header just before the memory handed to the
+// caller. The header is padded out to the alignment, so the caller's memory is aligned to it too.
+// By default that's the alignment of T, but no less than that of the header itself. Pass a larger
+// alignment, say 32 for a buffer used with AVX loads, if the memory needs more than T does.
+// Alignments larger than malloc provides are allocated with the platform's aligned allocation
+// functions instead.
+//
+// malloc and free are already thread safe, so whether the allocator can be shared between threads
+// only depends on how it counts. Pass ShardedTrackingCounters as counter_policy to share one.
+//
+// Pass HeapSampler, from HeapSampler.h, as sampling_policy to sample allocations for heap
+// profiling. Sampled allocations are marked in the top bit of their size header, so the header is
+// needed to use it.
+template<typename T = uint8_t, size_t alignment = 0, class counter_policy = TrackingCounters, TrackingMode mode = TrackingMode::SIZE_HEADER, class sampling_policy = NoHeapSampling>
+class TrackingAllocator : public counter_policy, public sampling_policy
+{
+public:
+	static constexpr size_t REQUESTED_ALIGNMENT = alignment != 0 ? alignment : alignof(T);
+	static constexpr size_t ALIGNMENT = REQUESTED_ALIGNMENT > alignof(uint64_t) ? REQUESTED_ALIGNMENT : alignof(uint64_t);
+	static constexpr size_t HEADER_SIZE = mode == TrackingMode::SIZE_HEADER ? ALIGNMENT : 0;
+
+	static_assert((ALIGNMENT & (ALIGNMENT - 1)) == 0, "Alignment must be a power of two");
+	static_assert(ALIGNMENT >= alignof(T), "Alignment must be at least that of T");
+	static_assert(!sampling_policy::SAMPLING || mode == TrackingMode::SIZE_HEADER, "Sampling needs the size header to mark sampled allocations");
+
 	T* allocate(size_t count)
 	{
+		// The size calculations below, including rounding up for aligned_alloc, would otherwise wrap
+		// around for a huge count and allocate a tiny block.
+		if (count > (SIZE_MAX - HEADER_SIZE - ALIGNMENT) / sizeof(T)) throw std::bad_alloc();
+
+		if (mode == TrackingMode::USABLE_SIZE)
+		{
+			// malloc(0) is allowed to return nullptr, which would look like a failure.
+			void* pMem = allocateBlock(count != 0 ? count * sizeof(T) : 1);
+			if (pMem == nullptr) throw std::bad_alloc();
+			this->onAllocate(getUsableSize(pMem));
+			return static_cast<T*>(pMem);
+		}
+
 		// Calculate the total size of this allocation tacking into account the size header we are
 		// going to attach to the allocation.
-		size_t size = sizeof(uint64_t) + (count * sizeof(T));
-		uint64_t* header = reinterpret_cast<uint64_t*>(malloc(size));
+		size_t size = HEADER_SIZE + (count * sizeof(T));
+		uint8_t* pBlock = reinterpret_cast<uint8_t*>(allocateBlock(size));
 		// Check that we were able to allocate memory.
-		if (header == nullptr) throw std::bad_alloc();
-		// Store the size of the allocation in the header and update the tracking info.
+		if (pBlock == nullptr) throw std::bad_alloc();
+		// Store the size of the allocation in the header, immediately before the caller's memory,
+		// and update the tracking info.
+		uint64_t* header = reinterpret_cast<uint64_t*>(pBlock + HEADER_SIZE) - 1;
 		*header = size;
-		_numAllocations++;
-		_totalAllocationsSize += size;
+		this->onAllocate(size);
+		if (this->countSampleBytes(size) && this->recordSample(pBlock + HEADER_SIZE, size))
+			*header |= SAMPLED_FLAG;
 		// Return the memory address immediately after the header. This is the memory the caller is
 		// able to use.
-		return reinterpret_cast<T*>(header + 1);
+		return reinterpret_cast<T*>(pBlock + HEADER_SIZE);
 	}
 
 	void deallocate(T* pMem)
 	{
 		// Ignore null requests, this is valid behaviour for "delete".
 		if (pMem == nullptr) return;
+
+		if (mode == TrackingMode::USABLE_SIZE)
+		{
+			this->onDeallocate(getUsableSize(pMem));
+			freeBlock(pMem);
+			return;
+		}
+
 		// Convert the address back to a uint64_t and go back to our header.
 		uint64_t* header = reinterpret_cast<uint64_t*>(pMem);
 		header--;
 		// Update our tracking info and free the memory.
-		_totalAllocationsSize -= (size_t)*header;
-		_numAllocations--;
-		free(header);
+		uint64_t size = *header;
+		if (sampling_policy::SAMPLING && (size & SAMPLED_FLAG) != 0)
+		{
+			this->releaseSample(pMem);
+			size &= ~SAMPLED_FLAG;
+		}
+		this->onDeallocate((size_t)size);
+		freeBlock(reinterpret_cast<uint8_t*>(pMem) - HEADER_SIZE);
 	}
 
 private:
-	unsigned int _numAllocations;
-	size_t _totalAllocationsSize;
-};
\ No newline at end of file
+	static constexpr uint64_t SAMPLED_FLAG = 1ull << 63;
+	// malloc's memory is already suitably aligned for anything up to max_align_t.
+	static constexpr bool OVER_ALIGNED = ALIGNMENT > alignof(std::max_align_t);
+
+	static void* allocateBlock(size_t size)
+	{
+		if (!OVER_ALIGNED) return malloc(size);
+#ifdef _WIN32
+		return _aligned_malloc(size, ALIGNMENT);
+#else
+		// aligned_alloc requires the size to be a multiple of the alignment.
+		return aligned_alloc(ALIGNMENT, (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+#endif
+	}
+
+	static void freeBlock(void* pBlock)
+	{
+#ifdef _WIN32
+		if (OVER_ALIGNED)
+		{
+			_aligned_free(pBlock);
+			return;
+		}
+#endif
+		free(pBlock);
+	}
+
+	static size_t getUsableSize(void* pBlock)
+	{
+#ifdef _WIN32
+		return OVER_ALIGNED ? _aligned_msize(pBlock, ALIGNMENT, 0) : _msize(pBlock);
+#else
+		return malloc_usable_size(pBlock);
+#endif
+	}
+};
@@ -0,0 +1,176 @@
+/*
+ * Thin wrapper around the operating system's virtual memory APIs so that allocators can request
+ * whole pages directly rather than going through the heap.
+ * Memory returned by the OS like this is always page aligned and zero filled. On Linux it comes
+ * from mmap and on Windows from VirtualAlloc.
+ */
+#pragma once
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+class VirtualMemory
+{
+public:
+	enum Flags
+	{
+		NONE = 0,
+		// Fault all of the pages in up front rather than on first touch. This moves the cost of
+		// the page faults to allocation time so that later accesses have predictable latency.
+		POPULATE = 1,
+		// Ask for the region to be backed by transparent huge pages to cut down on TLB misses.
+		// This is only a hint and is ignored where it isn't supported.
+		HUGE_PAGES = 2,
+	};
+
+	static size_t getPageSize()
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	static size_t roundToPages(size_t size)
+	{
+		size_t pageSize = getPageSize();
+		return (size + pageSize - 1) / pageSize * pageSize;
+	}
+
+	// Allocates a region of at least size bytes, rounded up to a whole number of pages. Throws
+	// std::bad_alloc on failure. Zero sized requests return nullptr.
+	static void* allocate(size_t size, int flags = NONE)
+	{
+		if (size == 0) return nullptr;
+		size = roundToPages(size);
+#ifdef _WIN32
+		void* pMem = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (pMem == nullptr) throw std::bad_alloc();
+		// Large pages on Windows need the SeLockMemoryPrivilege so the hint isn't supported, but we
+		// can still pre-fault the pages by touching each one.
+		if (flags & POPULATE)
+		{
+			size_t pageSize = getPageSize();
+			for (size_t offset = 0; offset < size; offset += pageSize)
+				reinterpret_cast<volatile char*>(pMem)[offset] = 0;
+		}
+#else
+		void* pMem;
+		if (flags & HUGE_PAGES)
+		{
+			pMem = mapHugePages(size, flags);
+		}
+		else
+		{
+			int mapFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+			if (flags & POPULATE) mapFlags |= MAP_POPULATE;
+#endif
+			pMem = mmap(nullptr, size, PROT_READ | PROT_WRITE, mapFlags, -1, 0);
+			if (pMem == MAP_FAILED) throw std::bad_alloc();
+		}
+#endif
+		return pMem;
+	}
+
+	// Hands the physical memory behind part of a region back to the OS while keeping the address
+	// range reserved. The range must be page aligned. On Windows the pages must be committed again
+	// before they are next touched, on Linux they are simply zero filled again on the next touch.
+	static void decommit(void* pMem, size_t size)
+	{
+		if (size == 0) return;
+#ifdef _WIN32
+		VirtualFree(pMem, size, MEM_DECOMMIT);
+#else
+		madvise(pMem, size, MADV_DONTNEED);
+#endif
+	}
+
+	// Makes a page aligned range previously passed to decommit usable again. Throws std::bad_alloc
+	// on failure.
+	static void commit(void* pMem, size_t size)
+	{
+		if (size == 0) return;
+#ifdef _WIN32
+		if (VirtualAlloc(pMem, size, MEM_COMMIT, PAGE_READWRITE) == nullptr) throw std::bad_alloc();
+#else
+		// Nothing to do, the mapping is still in place.
+		(void)pMem;
+#endif
+	}
+
+	// Releases a region previously returned by allocate. Size must be the same size that was
+	// requested from allocate.
+	static void release(void* pMem, size_t size)
+	{
+		if (pMem == nullptr) return;
+#ifdef _WIN32
+		(void)size;
+		VirtualFree(pMem, 0, MEM_RELEASE);
+#else
+		munmap(pMem, roundToPages(size));
+#endif
+	}
+
+private:
+#ifndef _WIN32
+	// Transparent huge pages on x86-64 and most ARM64 kernels.
+	static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	// Only whole huge pages that are aligned to their own size can be backed by one, so the start
+	// of the region is aligned to HUGE_PAGE_SIZE. That's done by reserving extra address space and
+	// unmapping whatever is left over on either side. Any part of the last huge page that's left
+	// over at the end uses normal pages. The region has to be marked for huge pages
+	// before it's populated, otherwise the pages are faulted in as normal pages and MAP_POPULATE
+	// would do exactly that.
+	static void* mapHugePages(size_t size, int flags)
+	{
+		size_t pageSize = getPageSize();
+		if (size > SIZE_MAX - HUGE_PAGE_SIZE) throw std::bad_alloc();
+		size_t reserved = size + HUGE_PAGE_SIZE - pageSize;
+		void* pReserved = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (pReserved == MAP_FAILED) throw std::bad_alloc();
+
+		char* pStart = static_cast<char*>(pReserved);
+		char* pMem = reinterpret_cast<char*>(((uintptr_t)pStart + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+		if (pMem != pStart) munmap(pStart, pMem - pStart);
+		size_t tail = (pStart + reserved) - (pMem + size);
+		if (tail != 0) munmap(pMem + size, tail);
+
+#ifdef MADV_HUGEPAGE
+		// Failure here isn't fatal, we just end up with normal pages.
+		madvise(pMem, size, MADV_HUGEPAGE);
+#endif
+		if (flags & POPULATE)
+		{
+			bool populated = false;
+#ifdef MADV_POPULATE_WRITE
+			// Linux 5.14 onwards.
+			populated = madvise(pMem, size, MADV_POPULATE_WRITE) == 0;
+#endif
+			if (!populated)
+			{
+				for (size_t offset = 0; offset < size; offset += pageSize)
+					reinterpret_cast<volatile char*>(pMem)[offset] = 0;
+			}
+		}
+		return pMem;
+	}
+#endif
+};
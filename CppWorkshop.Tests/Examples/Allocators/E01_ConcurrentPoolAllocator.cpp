@@ -0,0 +1,112 @@
+/*
+ * The PoolAllocator in the Pointers examples isn't thread safe. Its free list and allocation count
+ * are plain members and two threads calling construct at the same time can be handed the same
+ * slot. The simplest fix is to wrap the pool in a mutex, but that serialises every allocation and
+ * the threads end up queuing on the lock.
+ *
+ * ConcurrentPoolAllocator implements the free list as a lock-free stack instead. Threads race to
+ * update the head of the list with a compare-and-swap and the loser simply retries.
+ */
+#include "pch.h"
+#include <thread>
+#include "Allocators/ConcurrentPoolAllocator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E01_ConcurrentPoolAllocator)
+    {
+        struct Particle
+        {
+            Particle(int id, int value) :
+                id(id),
+                value(value)
+            {
+
+            }
+
+            int id;
+            int value;
+        };
+
+    public:
+        TEST_METHOD(Single_Threaded_Usage)
+        {
+            // The API is the same as PoolAllocator so it can be used as a drop in replacement.
+            ConcurrentPoolAllocator<Particle, 2> pool;
+            Assert::AreEqual(2, (int)pool.getPoolSize());
+            Assert::AreEqual(2u, pool.getFreeCount());
+
+            auto p1 = pool.construct(1, 10);
+            auto p2 = pool.construct(2, 20);
+            Assert::AreEqual(10, p1->value);
+            Assert::AreEqual(20, p2->value);
+            Assert::AreEqual(0u, pool.getFreeCount());
+            Assert::AreEqual(2u, pool.getAllocCount());
+
+            AssertThrows<std::bad_alloc>([&pool]() {
+                pool.construct(3, 30);
+            }, L"No more allocations should be possible from pool");
+
+            // The same release validation is performed as the single threaded pool.
+            pool.destruct(p1);
+            AssertThrows<std::invalid_argument>([&pool, p1]() {
+                pool.destruct(p1);
+            }, L"It should not be possible to double destruct element from pool");
+
+            Particle invalidAllocation(0, 0);
+            AssertThrows<std::invalid_argument>([&pool, &invalidAllocation]() {
+                pool.destruct(&invalidAllocation);
+            }, L"It should not be possible to destruct element not from pool");
+
+            pool.destruct(p2);
+            Assert::AreEqual(2u, pool.getFreeCount());
+            Assert::AreEqual(0u, pool.getAllocCount());
+
+            // Smart pointer wrappers work the same way too.
+            {
+                auto pShared = pool.make_shared(4, 40);
+                auto pUnique = pool.make_unique(5, 50);
+                Assert::AreEqual(40, pShared->value);
+                Assert::AreEqual(50, pUnique->value);
+                Assert::AreEqual(0u, pool.getFreeCount());
+            }
+            Assert::AreEqual(2u, pool.getFreeCount());
+        }
+
+        TEST_METHOD(Multi_Threaded_Usage)
+        {
+            // Several threads churn through allocations from a shared pool at the same time. If
+            // two threads were ever handed the same slot, one would overwrite the other's values
+            // and the check below would fail.
+            const int threadCount = 4;
+            const int iterations = 10000;
+            static ConcurrentPoolAllocator<Particle, 64> pool;
+            std::atomic<int> corruptions(0);
+
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCount; t++)
+            {
+                threads.emplace_back([t, &corruptions]() {
+                    Particle* held[8];
+                    for (int i = 0; i < iterations; i++)
+                    {
+                        for (int j = 0; j < 8; j++)
+                            held[j] = pool.construct(t, i * 8 + j);
+                        for (int j = 0; j < 8; j++)
+                        {
+                            if (held[j]->id != t || held[j]->value != i * 8 + j) corruptions++;
+                            pool.destruct(held[j]);
+                        }
+                    }
+                });
+            }
+            for (auto& thread : threads) thread.join();
+
+            Assert::AreEqual(0, corruptions.load(), L"Allocations were shared between threads");
+            Assert::AreEqual(64u, pool.getFreeCount());
+            Assert::AreEqual(0u, pool.getAllocCount());
+        }
+    };
+}
@@ -0,0 +1,120 @@
+/*
+ * MagazinePoolAllocator gives each thread its own small cache of free slots, called a magazine.
+ * Allocations and releases are served from the calling thread's magazine and only go to the shared
+ * pool when the magazine runs dry or overflows, moving a batch of slots at a time when they do.
+ */
+#include "pch.h"
+#include <atomic>
+#include <thread>
+#include "Allocators/MagazinePoolAllocator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E02_MagazinePoolAllocator)
+    {
+        struct Particle
+        {
+            Particle(int id, int value) :
+                id(id),
+                value(value)
+            {
+
+            }
+
+            int id;
+            int value;
+        };
+
+    public:
+        TEST_METHOD(Slots_Move_In_Batches)
+        {
+            MagazinePoolAllocator<Particle, 16, 4> pool;
+            Assert::AreEqual(16u, pool.getFreeCount());
+
+            // The first allocation pulls half a magazine's worth of slots out of the shared pool.
+            // Only one of them is in use, but the others are now reserved for this thread.
+            auto p1 = pool.construct(1, 10);
+            Assert::AreEqual(10, p1->value);
+            Assert::AreEqual(14u, pool.getFreeCount());
+
+            // The second allocation is served from the magazine without touching the shared pool.
+            auto p2 = pool.construct(2, 20);
+            Assert::AreEqual(14u, pool.getFreeCount());
+
+            // Releasing goes back into the magazine too.
+            pool.destruct(p1);
+            pool.destruct(p2);
+            Assert::AreEqual(14u, pool.getFreeCount());
+
+            // The usual release validation still applies.
+            AssertThrows<std::invalid_argument>([&pool, p1]() {
+                pool.destruct(p1);
+            }, L"It should not be possible to double destruct element from pool");
+
+            Particle invalidAllocation(0, 0);
+            AssertThrows<std::invalid_argument>([&pool, &invalidAllocation]() {
+                pool.destruct(&invalidAllocation);
+            }, L"It should not be possible to destruct element not from pool");
+
+            // A thread can hand its cached slots back, e.g. before it exits.
+            pool.releaseThreadCache();
+            Assert::AreEqual(16u, pool.getFreeCount());
+        }
+
+        TEST_METHOD(Pool_Exhaustion)
+        {
+            MagazinePoolAllocator<Particle, 3, 4> pool;
+            auto p1 = pool.construct(1, 1);
+            auto p2 = pool.construct(2, 2);
+            auto p3 = pool.construct(3, 3);
+            Assert::AreEqual(0u, pool.getFreeCount());
+
+            AssertThrows<std::bad_alloc>([&pool]() {
+                pool.construct(4, 4);
+            }, L"No more allocations should be possible from pool");
+
+            pool.destruct(p1);
+            pool.destruct(p2);
+            pool.destruct(p3);
+            pool.releaseThreadCache();
+            Assert::AreEqual(3u, pool.getFreeCount());
+        }
+
+        TEST_METHOD(Multi_Threaded_Usage)
+        {
+            // Each thread keeps its own magazine so the pool needs headroom for the slots that are
+            // cached by each thread on top of those actually in use.
+            const int threadCount = 4;
+            const int iterations = 10000;
+            static MagazinePoolAllocator<Particle, 4 * (8 + 16), 16> pool;
+            std::atomic<int> corruptions(0);
+
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCount; t++)
+            {
+                threads.emplace_back([t, &corruptions]() {
+                    Particle* held[8];
+                    for (int i = 0; i < iterations; i++)
+                    {
+                        for (int j = 0; j < 8; j++)
+                            held[j] = pool.construct(t, i * 8 + j);
+                        for (int j = 0; j < 8; j++)
+                        {
+                            if (held[j]->id != t || held[j]->value != i * 8 + j) corruptions++;
+                            pool.destruct(held[j]);
+                        }
+                    }
+                    // Exiting the thread would flush the magazine, but it's good practice to be
+                    // explicit about it.
+                    pool.releaseThreadCache();
+                });
+            }
+            for (auto& thread : threads) thread.join();
+
+            Assert::AreEqual(0, corruptions.load(), L"Allocations were shared between threads");
+            Assert::AreEqual((unsigned int)pool.getPoolSize(), pool.getFreeCount());
+        }
+    };
+}
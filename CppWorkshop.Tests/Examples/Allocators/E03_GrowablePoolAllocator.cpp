@@ -0,0 +1,100 @@
+/*
+ * A fixed size pool has to be sized for the worst case, which wastes memory the rest of the time.
+ * GrowablePoolAllocator builds its pool out of fixed size slabs instead. It starts empty, adds
+ * slabs as they are needed and can hand empty slabs back when the load drops again.
+ */
+#include "pch.h"
+#include "Allocators/GrowablePoolAllocator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E03_GrowablePoolAllocator)
+    {
+        struct Tank
+        {
+            Tank(int x, int y, int z) :
+                x(x),
+                y(y),
+                z(z)
+            {
+
+            }
+
+            int check() const { return x + y + z; }
+
+            int x;
+            int y;
+            int z;
+        };
+
+    public:
+        TEST_METHOD(Grows_On_Demand)
+        {
+            // Nothing is allocated up front.
+            GrowablePoolAllocator<Tank, 2> pool;
+            Assert::AreEqual(0, (int)pool.getPoolSize());
+            Assert::AreEqual(0, (int)pool.getSlabCount());
+
+            // The first construction allocates a slab.
+            auto t1 = pool.construct(1, 2, 3);
+            Assert::AreEqual(6, t1->check());
+            Assert::AreEqual(1, (int)pool.getSlabCount());
+            Assert::AreEqual(2, (int)pool.getPoolSize());
+            Assert::AreEqual(1u, pool.getFreeCount());
+
+            // Once the slab is full, another one is added rather than throwing bad_alloc.
+            auto t2 = pool.construct(4, 5, 6);
+            auto t3 = pool.construct(7, 8, 9);
+            Assert::AreEqual(24, t3->check());
+            Assert::AreEqual(2, (int)pool.getSlabCount());
+            Assert::AreEqual(3u, pool.getAllocCount());
+            Assert::AreEqual(1u, pool.getFreeCount());
+
+            // Ownership checks work across all of the slabs.
+            pool.destruct(t3);
+            AssertThrows<std::invalid_argument>([&pool, t3]() {
+                pool.destruct(t3);
+            }, L"It should not be possible to double destruct element from pool");
+
+            Tank invalidAllocation(0, 0, 0);
+            AssertThrows<std::invalid_argument>([&pool, &invalidAllocation]() {
+                pool.destruct(&invalidAllocation);
+            }, L"It should not be possible to destruct element not from pool");
+
+            // Empty slabs can be handed back. The first slab is still in use so it's kept.
+            Assert::AreEqual(1, (int)pool.releaseEmptySlabs());
+            Assert::AreEqual(1, (int)pool.getSlabCount());
+            Assert::AreEqual(0u, pool.getFreeCount());
+
+            pool.destruct(t1);
+            pool.destruct(t2);
+            Assert::AreEqual(1, (int)pool.releaseEmptySlabs());
+            Assert::AreEqual(0, (int)pool.getPoolSize());
+
+            // And the pool can grow again afterwards.
+            {
+                auto pUnique = pool.make_unique(3, 5, 7);
+                auto pShared = pool.make_shared(-3, -5, -7);
+                Assert::AreEqual(15, pUnique->check());
+                Assert::AreEqual(-15, pShared->check());
+                Assert::AreEqual(2u, pool.getAllocCount());
+            }
+            Assert::AreEqual(0u, pool.getAllocCount());
+        }
+
+        TEST_METHOD(Slab_Limit)
+        {
+            // An upper limit on the number of slabs can be given to stop the pool growing without
+            // bound.
+            GrowablePoolAllocator<Tank, 2, 2> pool;
+            for (int i = 0; i < 4; i++)
+                pool.construct(i, i, i);
+
+            AssertThrows<std::bad_alloc>([&pool]() {
+                pool.construct(0, 0, 0);
+            }, L"No more slabs should be allocated once the limit is reached");
+        }
+    };
+}
@@ -0,0 +1,185 @@
+/*
+ * DynamicPoolAllocator has its capacity passed to the constructor, so it can be sized from
+ * configuration at startup. The slots live in a single region of memory mapped directly from the
+ * OS rather than inline in the object, so even a very large pool is safe to declare on the stack.
+ */
+#include "pch.h"
+#include <algorithm>
+#include <map>
+#include "Allocators/DynamicPoolAllocator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E04_DynamicPoolAllocator)
+    {
+        struct Tank
+        {
+            Tank() : Tank(0, 0, 0) {}
+            Tank(int x, int y, int z) :
+                x(x),
+                y(y),
+                z(z)
+            {
+
+            }
+
+            int check() const { return x + y + z; }
+
+            int x;
+            int y;
+            int z;
+        };
+
+    public:
+        TEST_METHOD(Runtime_Capacity)
+        {
+            // The capacity would usually come from a config file or command line.
+            size_t capacity = 3;
+            DynamicPoolAllocator<Tank> pool(capacity);
+            Assert::AreEqual(3, (int)pool.getPoolSize());
+            Assert::AreEqual(3u, pool.getFreeCount());
+
+            auto t1 = pool.construct(1, 2, 3);
+            auto t2 = pool.construct(4, 5, 6);
+            auto t3 = pool.construct(7, 8, 9);
+            Assert::AreEqual(6, t1->check());
+            Assert::AreEqual(15, t2->check());
+            Assert::AreEqual(24, t3->check());
+            Assert::AreEqual(0u, pool.getFreeCount());
+
+            AssertThrows<std::bad_alloc>([&pool]() {
+                pool.construct();
+            }, L"No more allocations should be possible from pool");
+
+            pool.destruct(t1);
+            AssertThrows<std::invalid_argument>([&pool, t1]() {
+                pool.destruct(t1);
+            }, L"It should not be possible to double destruct element from pool");
+
+            Tank invalidAllocation;
+            AssertThrows<std::invalid_argument>([&pool, &invalidAllocation]() {
+                pool.destruct(&invalidAllocation);
+            }, L"It should not be possible to destruct element not from pool");
+
+            pool.destruct(t2);
+            pool.destruct(t3);
+            {
+                auto pShared = pool.make_shared(-3, -5, -7);
+                auto pUnique = pool.make_unique(3, 5, 7);
+                Assert::AreEqual(1u, pool.getFreeCount());
+            }
+            Assert::AreEqual(3u, pool.getFreeCount());
+        }
+
+        TEST_METHOD(Large_Pool_On_The_Stack)
+        {
+            // A PoolAllocator<Tank, 1000000> declared here would need around 16MB of stack. The
+            // dynamic pool object itself is only a handful of bytes.
+            DynamicPoolAllocator<Tank> pool(1000000, VirtualMemory::POPULATE | VirtualMemory::HUGE_PAGES);
+            Assert::IsTrue(sizeof(pool) < 64, L"Pool object should not contain the slots");
+
+            std::vector<Tank*> tanks;
+            for (int i = 0; i < 1000000; i++)
+                tanks.push_back(pool.construct(i, 0, 0));
+            Assert::AreEqual(0u, pool.getFreeCount());
+            Assert::AreEqual(999999, tanks.back()->check());
+
+            for (auto pTank : tanks)
+                pool.destruct(pTank);
+            Assert::AreEqual(1000000u, pool.getFreeCount());
+        }
+
+        TEST_METHOD(Lazy_Initialisation)
+        {
+            // Slots are only touched when they are first handed out, so creating a pool with room
+            // for ten million items is instant and only the pages holding the items we actually
+            // use are backed by physical memory.
+            DynamicPoolAllocator<Tank> pool(10000000);
+            Assert::AreEqual(10000000u, pool.getFreeCount());
+
+            Tank* pFirst = pool.construct(1, 2, 3);
+            Tank* pSecond = pool.construct(4, 5, 6);
+            Assert::AreEqual(2u, pool.getAllocCount());
+
+            // Reset is O(1) as well.
+            pool.reset();
+            Assert::AreEqual(0u, pool.getAllocCount());
+            AssertAreSame(pFirst, pool.construct(7, 8, 9));
+
+            // Items from before the reset are gone, so releasing one is an error.
+            AssertThrows<std::invalid_argument>([&pool, pSecond]() {
+                pool.destruct(pSecond);
+            }, L"It should not be possible to destruct an element from before a reset");
+            Assert::AreEqual(1u, pool.getAllocCount());
+        }
+
+        TEST_METHOD(Compaction)
+        {
+            // Fill a few pages worth of pool and then release most of it, keeping every tenth item
+            // and the very last one.
+            const int count = 4096;
+            DynamicPoolAllocator<Tank> pool(count);
+            std::vector<Tank*> tanks;
+            for (int i = 0; i < count; i++)
+                tanks.push_back(pool.construct(i, 0, 0));
+            std::map<int, Tank*> survivors;
+            for (int i = 0; i < count; i++)
+            {
+                if (i % 10 == 0 || i == count - 1) survivors[i] = tanks[i];
+                else pool.destruct(tanks[i]);
+            }
+            size_t committedBefore = pool.getCommittedSize();
+
+            // Anything holding on to pointers to pooled items needs to be told when they move.
+            int moves = 0;
+            Assert::IsTrue(pool.compact(std::chrono::nanoseconds::max(), [&survivors, &moves](Tank* pFrom, Tank* pTo) {
+                Assert::AreEqual(pTo->x, pTo->check());
+                AssertAreSame(pFrom, survivors[pTo->x]);
+                survivors[pTo->x] = pTo;
+                moves++;
+            }));
+            Assert::IsTrue(moves > 0);
+
+            // The survivors are now packed together at the front of the pool.
+            for (auto& survivor : survivors)
+            {
+                Assert::AreEqual(survivor.first, survivor.second->check());
+                Assert::IsTrue(survivor.second < tanks[survivors.size()], L"Item wasn't moved to the front of the pool");
+            }
+            Assert::IsTrue(pool.getCommittedSize() < committedBefore, L"Trailing pages weren't released");
+
+            // The pool carries on working as normal, committing pages again as needed.
+            for (size_t i = survivors.size(); i < count; i++)
+                pool.construct(0, 0, 0);
+            Assert::AreEqual(0u, pool.getFreeCount());
+            Assert::AreEqual(committedBefore, pool.getCommittedSize());
+            for (auto& survivor : survivors)
+                Assert::AreEqual(survivor.first, survivor.second->check());
+        }
+
+        TEST_METHOD(Compaction_Time_Budget)
+        {
+            const int count = 10000;
+            DynamicPoolAllocator<Tank> pool(count);
+            std::vector<Tank*> tanks;
+            for (int i = 0; i < count; i++)
+                tanks.push_back(pool.construct(i, 0, 0));
+            for (int i = 0; i < count; i += 2)
+                pool.destruct(tanks[i]);
+
+            // With no time to spare, compact only does a small amount of work per call, so it
+            // takes many calls to finish the job.
+            int calls = 1;
+            while (!pool.compact(std::chrono::nanoseconds(0)))
+            {
+                // The pool can still be used between calls.
+                pool.destruct(pool.construct(0, 0, 0));
+                calls++;
+            }
+            Assert::IsTrue(calls > 1);
+            Assert::AreEqual((unsigned int)count / 2, pool.getAllocCount());
+        }
+    };
+}
@@ -0,0 +1,96 @@
+/*
+ * DensePoolAllocator keeps its items packed together in one array and its free list in a separate
+ * array of small indexes. This makes the pool smaller for small types and means more live items
+ * fit into each cache line.
+ */
+#include "pch.h"
+#include "Allocators/DensePoolAllocator.h"
+#include "Allocators/PoolAllocator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E05_DensePoolAllocator)
+    {
+        struct Tank
+        {
+            Tank() : Tank(0, 0, 0) {}
+            Tank(int x, int y, int z) :
+                x(x),
+                y(y),
+                z(z)
+            {
+
+            }
+
+            int check() const { return x + y + z; }
+
+            int x;
+            int y;
+            int z;
+        };
+
+    public:
+        TEST_METHOD(Direct_Pool_Usage)
+        {
+            DensePoolAllocator<Tank, 3> pool;
+            Assert::AreEqual(3u, pool.getFreeCount());
+
+            auto t1 = pool.construct(1, 2, 3);
+            auto t2 = pool.construct(4, 5, 6);
+            auto t3 = pool.construct(7, 8, 9);
+            Assert::AreEqual(6, t1->check());
+            Assert::AreEqual(15, t2->check());
+            Assert::AreEqual(24, t3->check());
+            Assert::AreEqual(0u, pool.getFreeCount());
+
+            // A fresh pool hands out items next to each other in memory.
+            AssertAreSame(t1 + 1, t2);
+            AssertAreSame(t2 + 1, t3);
+
+            AssertThrows<std::bad_alloc>([&pool]() {
+                pool.construct();
+            }, L"No more allocations should be possible from pool");
+
+            pool.destruct(t2);
+            AssertThrows<std::invalid_argument>([&pool, t2]() {
+                pool.destruct(t2);
+            }, L"It should not be possible to double destruct element from pool");
+
+            // Pointers into the middle of an item are rejected too.
+            AssertThrows<std::invalid_argument>([&pool, t1]() {
+                pool.destruct(reinterpret_cast<Tank*>(&t1->y));
+            }, L"It should not be possible to destruct a pointer to the middle of an item");
+
+            Tank invalidAllocation;
+            AssertThrows<std::invalid_argument>([&pool, &invalidAllocation]() {
+                pool.destruct(&invalidAllocation);
+            }, L"It should not be possible to destruct element not from pool");
+
+            pool.destruct(t1);
+            pool.destruct(t3);
+            {
+                auto pShared = pool.make_shared(-3, -5, -7);
+                auto pUnique = pool.make_unique(3, 5, 7);
+                Assert::AreEqual(1u, pool.getFreeCount());
+            }
+            Assert::AreEqual(3u, pool.getFreeCount());
+        }
+
+        TEST_METHOD(Memory_Footprint)
+        {
+            // The free list index for a small pool is a single byte, and 2 bytes for larger pools.
+            Assert::AreEqual(sizeof(uint8_t), sizeof(DensePoolIndex<100>));
+            Assert::AreEqual(sizeof(uint16_t), sizeof(DensePoolIndex<1000>));
+            Assert::AreEqual(sizeof(uint32_t), sizeof(DensePoolIndex<100000>));
+
+            // So a pool of Tanks is much smaller than the equivalent PoolAllocator.
+            const size_t poolSize = 1000;
+            size_t denseSize = sizeof(DensePoolAllocator<Tank, poolSize>);
+            size_t pooledSize = sizeof(PoolAllocator<Tank, poolSize>);
+            Assert::IsTrue(denseSize <= poolSize * (sizeof(Tank) + sizeof(uint16_t)) + 16);
+            Assert::IsTrue(denseSize < pooledSize);
+        }
+    };
+}
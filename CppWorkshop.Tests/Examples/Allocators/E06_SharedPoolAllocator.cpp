@@ -0,0 +1,114 @@
+/*
+ * SharedPoolAllocator is for items that will be owned by shared_ptrs. Each pool slot holds the item
+ * and the shared_ptr control block together, so creating a shared item is a single pool allocation
+ * and never touches the global heap.
+ */
+#include "pch.h"
+#include "Allocators/SharedPoolAllocator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E06_SharedPoolAllocator)
+    {
+        struct Tank
+        {
+            Tank(int x, int y, int z, int* pDestructCount) :
+                x(x),
+                y(y),
+                z(z),
+                pDestructCount(pDestructCount)
+            {
+
+            }
+
+            ~Tank()
+            {
+                (*pDestructCount)++;
+            }
+
+            int check() const { return x + y + z; }
+
+            int x;
+            int y;
+            int z;
+            int* pDestructCount;
+        };
+
+        struct alignas(32) Vector4
+        {
+            float x, y, z, w;
+        };
+
+    public:
+        TEST_METHOD(Shared_Item_Lifetime)
+        {
+            SharedPoolAllocator<Tank, 2> pool;
+            int destructCount = 0;
+            Assert::AreEqual(2u, pool.getFreeCount());
+
+            auto t1 = pool.make_shared(1, 2, 3, &destructCount);
+            Assert::AreEqual(6, t1->check());
+            Assert::AreEqual(1u, pool.getAllocCount());
+
+            // Copies share the same slot.
+            auto t2 = t1;
+            Assert::AreEqual(1u, pool.getAllocCount());
+            Assert::AreEqual(2L, t1.use_count());
+
+            t1.reset();
+            Assert::AreEqual(0, destructCount);
+            t2.reset();
+            Assert::AreEqual(1, destructCount);
+            Assert::AreEqual(2u, pool.getFreeCount());
+        }
+
+        TEST_METHOD(Weak_Pointers_Hold_The_Slot)
+        {
+            SharedPoolAllocator<Tank, 2> pool;
+            int destructCount = 0;
+
+            auto t1 = pool.make_shared(1, 2, 3, &destructCount);
+            std::weak_ptr<Tank> weak = t1;
+
+            // The item is destroyed along with the last shared_ptr, but the control block lives in
+            // the same slot and is still needed by the weak_ptr.
+            t1.reset();
+            Assert::AreEqual(1, destructCount);
+            Assert::IsTrue(weak.expired());
+            Assert::AreEqual(1u, pool.getAllocCount());
+
+            weak.reset();
+            Assert::AreEqual(0u, pool.getAllocCount());
+        }
+
+        TEST_METHOD(Pool_Exhaustion)
+        {
+            SharedPoolAllocator<Tank, 2> pool;
+            int destructCount = 0;
+
+            auto t1 = pool.make_shared(1, 2, 3, &destructCount);
+            auto t2 = pool.make_shared(4, 5, 6, &destructCount);
+            AssertThrows<std::bad_alloc>([&pool, &destructCount]() {
+                pool.make_shared(7, 8, 9, &destructCount);
+            }, L"No more allocations should be possible from pool");
+
+            t1.reset();
+            auto t3 = pool.make_shared(7, 8, 9, &destructCount);
+            Assert::AreEqual(24, t3->check());
+        }
+
+        TEST_METHOD(Over_Aligned_Types)
+        {
+            SharedPoolAllocator<Vector4, 4> pool;
+            std::shared_ptr<Vector4> items[4];
+            for (auto& item : items)
+            {
+                item = pool.make_shared();
+                Assert::AreEqual((size_t)0, reinterpret_cast<uintptr_t>(item.get()) % alignof(Vector4), L"Item is not correctly aligned");
+            }
+            Assert::AreEqual((size_t)0, pool.getSlotSize() % alignof(Vector4));
+        }
+    };
+}
@@ -0,0 +1,121 @@
+/*
+ * HandlePoolAllocator hands out small handles instead of pointers. A handle records which slot the
+ * item is in and which generation of that slot it belongs to, so a handle to an item that has been
+ * released is detected as stale even after the slot has been reused.
+ */
+#include "pch.h"
+#include "Allocators/HandlePoolAllocator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E07_HandlePoolAllocator)
+    {
+        struct Tank
+        {
+            Tank(int x, int y, int z) :
+                x(x),
+                y(y),
+                z(z)
+            {
+
+            }
+
+            int check() const { return x + y + z; }
+
+            int x;
+            int y;
+            int z;
+        };
+
+        // Counts how many instances are alive.
+        struct Counted
+        {
+            Counted(int* pLive) : pLive(pLive) { (*pLive)++; }
+            ~Counted() { (*pLive)--; }
+            int* pLive;
+        };
+
+        typedef HandlePoolAllocator<Tank, 3> TankPool;
+
+    public:
+        TEST_METHOD(Handles)
+        {
+            TankPool pool;
+            static_assert(sizeof(TankPool::Handle) == 8, "Handles should be 8 bytes");
+
+            auto h1 = pool.construct(1, 2, 3);
+            auto h2 = pool.construct(4, 5, 6);
+            Assert::AreEqual(2u, pool.getAllocCount());
+            Assert::IsTrue(pool.isValid(h1));
+            Assert::AreEqual(6, pool.resolve(h1)->check());
+            Assert::AreEqual(15, pool.resolve(h2)->check());
+
+            // Default constructed handles never resolve.
+            Assert::IsFalse(pool.isValid(TankPool::Handle()));
+            Assert::IsNull(pool.resolve(TankPool::Handle()));
+        }
+
+        TEST_METHOD(Stale_Handles)
+        {
+            TankPool pool;
+            auto h1 = pool.construct(1, 2, 3);
+            pool.destruct(h1);
+            Assert::IsFalse(pool.isValid(h1));
+            Assert::IsNull(pool.resolve(h1));
+
+            // The slot gets reused, but the old handle still doesn't resolve to the new item.
+            auto h2 = pool.construct(4, 5, 6);
+            Assert::AreEqual(h1.index, h2.index);
+            Assert::IsTrue(h1 != h2);
+            Assert::IsNull(pool.resolve(h1));
+            Assert::AreEqual(15, pool.resolve(h2)->check());
+
+            AssertThrows<std::invalid_argument>([&pool, h1]() {
+                pool.destruct(h1);
+            }, L"It should not be possible to destruct via a stale handle");
+
+            AssertThrows<std::invalid_argument>([&pool]() {
+                pool.destruct(TankPool::Handle{ 3, 1 });
+            }, L"It should not be possible to destruct element not from pool");
+        }
+
+        TEST_METHOD(Pool_Exhaustion)
+        {
+            TankPool pool;
+            pool.construct(1, 1, 1);
+            auto h2 = pool.construct(2, 2, 2);
+            pool.construct(3, 3, 3);
+            AssertThrows<std::bad_alloc>([&pool]() {
+                pool.construct(4, 4, 4);
+            }, L"No more allocations should be possible from pool");
+
+            pool.destruct(h2);
+            auto h4 = pool.construct(4, 4, 4);
+            Assert::AreEqual(12, pool.resolve(h4)->check());
+        }
+
+        TEST_METHOD(Reset_Invalidates_Handles)
+        {
+            int live = 0;
+            HandlePoolAllocator<Counted, 4> pool;
+            auto h1 = pool.construct(&live);
+            pool.construct(&live);
+            Assert::AreEqual(2, live);
+
+            // The pool owns its items, so resetting it destructs them.
+            pool.reset();
+            Assert::AreEqual(0, live);
+            Assert::AreEqual(0u, pool.getAllocCount());
+            Assert::IsFalse(pool.isValid(h1));
+
+            {
+                HandlePoolAllocator<Counted, 4> scopedPool;
+                scopedPool.construct(&live);
+                Assert::AreEqual(1, live);
+            }
+            Assert::AreEqual(0, live, L"Items should be destructed along with the pool");
+        }
+    };
+}
@@ -0,0 +1,90 @@
+/*
+ * PoolStlAllocator lets node based standard containers allocate their nodes from a pool rather
+ * than the global heap. The container rebinds the allocator to its node type, so each kind of node
+ * gets a pool of its own.
+ */
+#include "pch.h"
+#include <list>
+#include <map>
+#include <unordered_map>
+#include "Allocators/PoolStlAllocator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E08_PoolStlAllocator)
+    {
+        // Each test uses its own tag so that the tests don't share pools.
+        struct ListTag {};
+        struct MapTag {};
+        struct UnorderedMapTag {};
+        struct ArrayTag {};
+
+    public:
+        TEST_METHOD(List_Nodes)
+        {
+            std::list<int, PoolStlAllocator<int, 8, ListTag>> items;
+            for (int i = 0; i < 4; i++)
+                items.push_back(i);
+            Assert::AreEqual(6, items.front() + items.back() + 3);
+
+            // Once the pool is full the container sees the usual std::bad_alloc, and releasing a
+            // node makes room for another.
+            AssertThrows<std::bad_alloc>([&items]() {
+                for (int i = 0; i < 100; i++)
+                    items.push_back(i);
+            }, L"No more allocations should be possible from pool");
+            size_t count = items.size();
+            items.pop_front();
+            items.push_back(-1);
+            Assert::AreEqual(count, items.size());
+            Assert::AreEqual(-1, items.back());
+        }
+
+        TEST_METHOD(Map_Nodes)
+        {
+            std::map<int, int, std::less<int>, PoolStlAllocator<std::pair<const int, int>, 100, MapTag>> items;
+            for (int i = 0; i < 50; i++)
+                items[i] = i * i;
+            items.erase(10);
+            Assert::AreEqual(49, (int)items.size());
+            Assert::AreEqual(400, items[20]);
+
+            // Copies allocate from the same pools.
+            auto copy = items;
+            Assert::AreEqual(400, copy[20]);
+        }
+
+        TEST_METHOD(Unordered_Map_Nodes)
+        {
+            std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, PoolStlAllocator<std::pair<const int, int>, 1000, UnorderedMapTag>> items;
+            for (int i = 0; i < 500; i++)
+                items[i] = -i;
+            for (int i = 0; i < 500; i += 2)
+                items.erase(i);
+            Assert::AreEqual(250, (int)items.size());
+            Assert::AreEqual(-301, items[301]);
+        }
+
+        TEST_METHOD(Arrays)
+        {
+            struct alignas(256) Page
+            {
+                char data[256];
+            };
+
+            // Arrays come from the global heap, which still has to honour the type's alignment.
+            PoolStlAllocator<Page, 4, ArrayTag> allocator;
+            Page* pPages = allocator.allocate(3);
+            Assert::AreEqual((uintptr_t)0, (uintptr_t)pPages % 256);
+            allocator.deallocate(pPages, 3);
+
+            // A count whose size in bytes can't be represented fails rather than wrapping around
+            // to a small allocation.
+            AssertThrows<std::bad_array_new_length>([&allocator]() {
+                allocator.allocate(SIZE_MAX / 16);
+            }, L"The size of the array should overflow");
+        }
+    };
+}
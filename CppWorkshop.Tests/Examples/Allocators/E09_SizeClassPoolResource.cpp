@@ -0,0 +1,97 @@
+/*
+ * SizeClassPoolResource is a std::pmr::memory_resource built from a set of pools, one per size
+ * class. Small allocations are rounded up to the nearest size class and served from its pool, and
+ * large ones are passed through to an upstream resource.
+ */
+#include "pch.h"
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include "Allocators/SizeClassPoolResource.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E09_SizeClassPoolResource)
+    {
+        // An upstream resource that counts the requests that reach it.
+        class CountingResource : public std::pmr::memory_resource
+        {
+        public:
+            int allocations = 0;
+            int live = 0;
+
+        protected:
+            void* do_allocate(size_t bytes, size_t alignment) override
+            {
+                allocations++;
+                live++;
+                return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+            }
+
+            void do_deallocate(void* pMem, size_t bytes, size_t alignment) override
+            {
+                live--;
+                std::pmr::new_delete_resource()->deallocate(pMem, bytes, alignment);
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+            {
+                return this == &other;
+            }
+        };
+
+    public:
+        TEST_METHOD(Size_Classes)
+        {
+            Assert::AreEqual((size_t)8, SizeClassPoolResource::getBlockSize(1, 1));
+            Assert::AreEqual((size_t)16, SizeClassPoolResource::getBlockSize(12, 4));
+            Assert::AreEqual((size_t)64, SizeClassPoolResource::getBlockSize(64));
+            Assert::AreEqual((size_t)1024, SizeClassPoolResource::getBlockSize(1000));
+            // A small allocation that needs a larger alignment uses a larger block. Like
+            // memory_resource::allocate, the alignment defaults to that of std::max_align_t.
+            Assert::AreEqual((size_t)16, SizeClassPoolResource::getBlockSize(4));
+            // Too large to pool.
+            Assert::AreEqual((size_t)0, SizeClassPoolResource::getBlockSize(1025));
+        }
+
+        TEST_METHOD(Pmr_Containers)
+        {
+            CountingResource upstream;
+            {
+                SizeClassPoolResource resource(&upstream);
+                std::pmr::list<int> items(&resource);
+                for (int i = 0; i < 1000; i++)
+                    items.push_back(i);
+
+                // A thousand list nodes only needed a chunk or two from upstream. Debug builds of
+                // some standard libraries make extra small allocations for iterator checking, which
+                // may need a chunk of a different size class.
+                int warmedUp = upstream.allocations;
+                Assert::IsTrue(warmedUp <= 2);
+
+                // Released blocks are reused rather than going back upstream.
+                for (int round = 0; round < 10; round++)
+                {
+                    items.clear();
+                    for (int i = 0; i < 1000; i++)
+                        items.push_back(i);
+                }
+                Assert::AreEqual(warmedUp, upstream.allocations);
+
+                // Large allocations go straight through to upstream.
+                std::pmr::vector<char> buffer(4096, 'x', &resource);
+                Assert::IsTrue(upstream.allocations > warmedUp);
+
+                // Blocks are correctly aligned for what's stored in them.
+                std::pmr::vector<double> values({ 1.0, 2.0, 3.0 }, &resource);
+                Assert::AreEqual((size_t)0, reinterpret_cast<uintptr_t>(values.data()) % alignof(double));
+            }
+
+            // Everything is handed back when the resource is destroyed.
+            Assert::AreEqual(0, upstream.live);
+        }
+    };
+}
@@ -0,0 +1,295 @@
+/*
+ * TrackingAllocator wraps malloc/free and keeps count of how many allocations are live and how
+ * much memory they're using. By default the counts are plain integers so one allocator must only
+ * be used by one thread at a time. ShardedTrackingCounters makes it safe to share between threads
+ * without every thread fighting over the same counters.
+ *
+ * Each allocation has a small header holding its size, padded so that the caller's memory keeps
+ * whatever alignment it needs. TrackingMode::USABLE_SIZE does without the header and asks the heap
+ * for the size instead.
+ *
+ * HeapSampler samples a fraction of allocations along with where they were made from, and writes
+ * them out as a profile pprof can read.
+ *
+ * GlobalTrackingCounters keeps counts for the whole process. Building with TRACK_GLOBAL_NEW, as this
+ * project's TrackedNew configuration does, routes the global operator new and delete through them
+ * too.
+ */
+#include "pch.h"
+#include <new>
+#include <thread>
+#include <vector>
+#include "Allocators/HeapSampler.h"
+#include "Allocators/TrackedGlobalNew.h"
+#include "Allocators/TrackingAllocator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Allocators
+{
+    TEST_CLASS(E10_TrackingAllocator)
+    {
+    public:
+        TEST_METHOD(Tracking)
+        {
+            TrackingAllocator<uint32_t> allocator;
+            uint32_t* pFirst = allocator.allocate(4);
+            uint32_t* pSecond = allocator.allocate(1);
+            Assert::AreEqual(2u, allocator.getNumAllocations());
+            // Each allocation also has an 8 byte header.
+            Assert::AreEqual((size_t)(8 + 16 + 8 + 4), allocator.getTotalAllocationsSize());
+
+            allocator.deallocate(pFirst);
+            Assert::AreEqual(1u, allocator.getNumAllocations());
+            Assert::AreEqual((size_t)(8 + 4), allocator.getTotalAllocationsSize());
+            allocator.deallocate(pSecond);
+            allocator.deallocate(nullptr);
+            Assert::AreEqual(0u, allocator.getNumAllocations());
+            Assert::AreEqual((size_t)0, allocator.getTotalAllocationsSize());
+        }
+
+        TEST_METHOD(Huge_Allocations)
+        {
+            // A count so large that the size including the header doesn't fit in a size_t must
+            // fail rather than wrap around to a small allocation.
+            TrackingAllocator<uint32_t> allocator;
+            TrackingAllocator<uint8_t, 64> cacheLines;
+            TrackingAllocator<uint8_t, 0, TrackingCounters, TrackingMode::USABLE_SIZE> headerless;
+            AssertThrows<std::bad_alloc>([&allocator]() {
+                allocator.allocate(SIZE_MAX / sizeof(uint32_t));
+            }, L"The size of the allocation should not wrap around");
+            AssertThrows<std::bad_alloc>([&cacheLines]() {
+                cacheLines.allocate(SIZE_MAX - 8);
+            }, L"The size of the allocation should not wrap around");
+            AssertThrows<std::bad_alloc>([&headerless]() {
+                headerless.allocate(SIZE_MAX);
+            }, L"The size of the allocation should not wrap around");
+            Assert::AreEqual(0u, allocator.getNumAllocations() + cacheLines.getNumAllocations() + headerless.getNumAllocations());
+        }
+
+        TEST_METHOD(Alignment)
+        {
+            struct alignas(32) Matrix
+            {
+                float values[8];
+            };
+
+            // The header is padded so the caller's memory keeps the requested alignment.
+            TrackingAllocator<uint8_t, 16> buffers;
+            TrackingAllocator<uint8_t, 64> cacheLines;
+            TrackingAllocator<Matrix> matrices;
+            Assert::AreEqual((size_t)16, buffers.HEADER_SIZE);
+            Assert::AreEqual((size_t)32, matrices.HEADER_SIZE);
+
+            for (int i = 0; i < 16; i++)
+            {
+                uint8_t* pBuffer = buffers.allocate(1 + i * 7);
+                uint8_t* pLine = cacheLines.allocate(1 + i * 7);
+                Matrix* pMatrix = matrices.allocate(1 + i);
+                Assert::AreEqual((uintptr_t)0, (uintptr_t)pBuffer % 16);
+                Assert::AreEqual((uintptr_t)0, (uintptr_t)pLine % 64);
+                Assert::AreEqual((uintptr_t)0, (uintptr_t)pMatrix % 32);
+                memset(pLine, 0xff, 1 + i * 7);
+                buffers.deallocate(pBuffer);
+                cacheLines.deallocate(pLine);
+                matrices.deallocate(pMatrix);
+            }
+            Assert::AreEqual(0u, buffers.getNumAllocations() + cacheLines.getNumAllocations() + matrices.getNumAllocations());
+
+            // The size tracked includes the padded header.
+            Matrix* pMatrix = matrices.allocate(2);
+            Assert::AreEqual((size_t)(32 + 2 * 32), matrices.getTotalAllocationsSize());
+            matrices.deallocate(pMatrix);
+            Assert::AreEqual((size_t)0, matrices.getTotalAllocationsSize());
+        }
+
+        TEST_METHOD(Usable_Size)
+        {
+            TrackingAllocator<uint64_t, 0, TrackingCounters, TrackingMode::USABLE_SIZE> allocator;
+            TrackingAllocator<uint8_t, 64, TrackingCounters, TrackingMode::USABLE_SIZE> cacheLines;
+            Assert::AreEqual((size_t)0, allocator.HEADER_SIZE);
+
+            // Without a header, what's tracked is what the heap set aside, which is at least what
+            // was asked for.
+            uint64_t* pFirst = allocator.allocate(3);
+            uint64_t* pSecond = allocator.allocate(1);
+            uint8_t* pLine = cacheLines.allocate(100);
+            Assert::AreEqual(2u, allocator.getNumAllocations());
+            Assert::IsTrue(allocator.getTotalAllocationsSize() >= 4 * sizeof(uint64_t));
+            Assert::IsTrue(cacheLines.getTotalAllocationsSize() >= 100);
+            Assert::AreEqual((uintptr_t)0, (uintptr_t)pLine % 64);
+            memset(pFirst, 0xff, 3 * sizeof(uint64_t));
+
+            size_t total = allocator.getTotalAllocationsSize();
+            allocator.deallocate(pSecond);
+            Assert::AreEqual(1u, allocator.getNumAllocations());
+            Assert::IsTrue(allocator.getTotalAllocationsSize() >= 3 * sizeof(uint64_t));
+            Assert::IsTrue(allocator.getTotalAllocationsSize() < total);
+
+            allocator.deallocate(pFirst);
+            cacheLines.deallocate(pLine);
+            Assert::AreEqual((size_t)0, allocator.getTotalAllocationsSize());
+            Assert::AreEqual((size_t)0, cacheLines.getTotalAllocationsSize());
+        }
+
+        TEST_METHOD(Heap_Sampling)
+        {
+            typedef TrackingAllocator<uint8_t, 0, TrackingCounters, TrackingMode::SIZE_HEADER, HeapSampler> SampledAllocator;
+
+            // With a huge period hardly anything is sampled.
+            HeapSampler::setSamplePeriod(1024 * 1024 * 1024);
+            SampledAllocator allocator;
+            std::vector<uint8_t*> items;
+            for (int i = 0; i < 10; i++)
+                items.push_back(allocator.allocate(100));
+            Assert::AreEqual((size_t)0, allocator.getLiveSampleCount());
+            for (uint8_t* pItem : items)
+                allocator.deallocate(pItem);
+            items.clear();
+
+            // With a period of a byte everything is.
+            HeapSampler::setSamplePeriod(1);
+            for (int i = 0; i < 10; i++)
+                items.push_back(allocator.allocate(100));
+            Assert::AreEqual((size_t)10, allocator.getLiveSampleCount());
+            for (int i = 0; i < 4; i++)
+                allocator.deallocate(items[i]);
+            Assert::AreEqual((size_t)6, allocator.getLiveSampleCount());
+            // Sampling doesn't change what's tracked.
+            Assert::AreEqual(6u, allocator.getNumAllocations());
+            Assert::AreEqual((size_t)6 * (8 + 100), allocator.getTotalAllocationsSize());
+
+            // The profile has a header with the totals, then one line per stack. Every allocation
+            // here came from the same place, so there's only one stack.
+            FILE* pFile = tmpfile();
+            allocator.writeProfile(pFile);
+            rewind(pFile);
+            char line[1024];
+            Assert::IsNotNull(fgets(line, sizeof(line), pFile));
+            Assert::AreEqual("heap profile: 6: 648 [10: 1080] @ heap_v2/1\n", line);
+            Assert::IsNotNull(fgets(line, sizeof(line), pFile));
+            Assert::AreEqual(0, strncmp(line, "6: 648 [10: 1080] @ 0x", 22));
+            fclose(pFile);
+            HeapSampler::setSamplePeriod(HeapSampler::DEFAULT_SAMPLE_PERIOD);
+
+            for (int i = 4; i < 10; i++)
+                allocator.deallocate(items[i]);
+            Assert::AreEqual((size_t)0, allocator.getLiveSampleCount());
+            Assert::AreEqual((size_t)0, allocator.getDroppedSampleCount());
+        }
+
+        TEST_METHOD(Sharded_Counters)
+        {
+            const int THREADS = 8;
+            const int ITERATIONS = 10000;
+            TrackingAllocator<uint64_t, 0, ShardedTrackingCounters> allocator;
+
+            // Each thread churns through allocations and then keeps one.
+            std::vector<uint64_t*> kept(THREADS);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < THREADS; t++)
+            {
+                threads.emplace_back([&allocator, &kept, t]() {
+                    for (int i = 0; i < ITERATIONS; i++)
+                        allocator.deallocate(allocator.allocate(1 + i % 4));
+                    kept[t] = allocator.allocate(2);
+                });
+            }
+            for (auto& thread : threads) thread.join();
+
+            Assert::AreEqual((unsigned int)THREADS, allocator.getNumAllocations());
+            Assert::AreEqual((size_t)THREADS * (8 + 16), allocator.getTotalAllocationsSize());
+
+            // Each thread frees the allocation kept by another thread, so it's taken off a different
+            // shard to the one that counted it.
+            threads.clear();
+            for (int t = 0; t < THREADS; t++)
+                threads.emplace_back([&allocator, &kept, t]() { allocator.deallocate(kept[(t + 1) % THREADS]); });
+            for (auto& thread : threads) thread.join();
+
+            Assert::AreEqual(0u, allocator.getNumAllocations());
+            Assert::AreEqual((size_t)0, allocator.getTotalAllocationsSize());
+        }
+
+        TEST_METHOD(Global_Counts)
+        {
+            // Any TrackingAllocator can add its allocations to the process wide counts.
+            TrackingAllocator<uint8_t, 0, GlobalTrackingCounters> allocator;
+            auto before = GlobalTrackingCounters::getCounts();
+            uint8_t* pFirst = allocator.allocate(100);
+            uint8_t* pSecond = allocator.allocate(20);
+            auto during = GlobalTrackingCounters::getCounts();
+            allocator.deallocate(pFirst);
+            allocator.deallocate(pSecond);
+            auto after = GlobalTrackingCounters::getCounts();
+
+            Assert::AreEqual(before.liveAllocations + 2, during.liveAllocations);
+            Assert::AreEqual(before.liveBytes + 8 + 100 + 8 + 20, during.liveBytes);
+            Assert::AreEqual(before.liveAllocations, after.liveAllocations);
+            Assert::AreEqual(before.liveBytes, after.liveBytes);
+            // The totals only ever go up.
+            Assert::AreEqual(before.totalAllocations + 2, after.totalAllocations);
+            Assert::AreEqual(before.totalBytes + 8 + 100 + 8 + 20, after.totalBytes);
+        }
+
+#ifdef TRACK_GLOBAL_NEW
+        // Stores the pointer somewhere the compiler can't see through, so the allocation has to be
+        // made.
+        static void* escape(void* pMem)
+        {
+            static void* volatile s_pEscaped;
+            s_pEscaped = pMem;
+            return pMem;
+        }
+
+        TEST_METHOD(Global_New)
+        {
+            // The compiler is free to leave out an allocation whose memory is never used, even when
+            // operator new is called directly, so every pointer is passed to escape() first.
+            Assert::IsTrue(GlobalTrackingCounters::TRACKS_GLOBAL_NEW);
+            auto before = GlobalTrackingCounters::getCounts();
+            void* pValue = escape(::operator new(sizeof(int)));
+            void* pValues = escape(::operator new[](10 * sizeof(int)));
+            void* pPage = escape(::operator new(256, std::align_val_t(256)));
+            void* pNoThrowValue = escape(::operator new(sizeof(int), std::nothrow));
+            void* pNoThrowPage = escape(::operator new(256, std::align_val_t(256), std::nothrow));
+            auto during = GlobalTrackingCounters::getCounts();
+            Assert::AreEqual(before.liveAllocations + 5, during.liveAllocations);
+            Assert::AreEqual(before.totalAllocations + 5, during.totalAllocations);
+            // The aligned forms keep the alignment asked for.
+            Assert::AreEqual((uintptr_t)0, (uintptr_t)pPage % 256);
+            Assert::AreEqual((uintptr_t)0, (uintptr_t)pNoThrowPage % 256);
+
+            ::operator delete(pValue);
+            ::operator delete[](pValues);
+            ::operator delete(pPage, std::align_val_t(256));
+            ::operator delete(pNoThrowValue);
+            ::operator delete(pNoThrowPage, std::align_val_t(256));
+            auto after = GlobalTrackingCounters::getCounts();
+            Assert::AreEqual(before.liveAllocations, after.liveAllocations);
+            Assert::AreEqual(before.liveBytes, after.liveBytes);
+
+            // A large alignment costs at most the alignment in padding, not a header that size
+            // as well.
+            const size_t alignment = 64 * 1024;
+            void* pAligned = escape(::operator new(8, std::align_val_t(alignment)));
+            Assert::AreEqual((uintptr_t)0, (uintptr_t)pAligned % alignment);
+            Assert::IsTrue(GlobalTrackingCounters::getCounts().liveBytes - before.liveBytes < alignment + 64);
+            ::operator delete(pAligned, std::align_val_t(alignment));
+
+            // A request too big to ever succeed fails, rather than the size wrapping around to a
+            // small allocation. volatile stops the compiler from spotting that at compile time.
+            volatile size_t huge = SIZE_MAX;
+            AssertThrows<std::bad_alloc>([&huge]() {
+                escape(::operator new(huge));
+            }, L"A huge allocation should fail");
+            AssertThrows<std::bad_alloc>([&huge]() {
+                escape(::operator new(huge, std::align_val_t(256)));
+            }, L"A huge allocation should fail");
+            Assert::IsNull(escape(::operator new(huge, std::nothrow)));
+            Assert::IsNull(escape(::operator new(huge, std::align_val_t(256), std::nothrow)));
+            Assert::AreEqual(before.liveAllocations, GlobalTrackingCounters::getCounts().liveAllocations);
+        }
+#endif
+    };
+}
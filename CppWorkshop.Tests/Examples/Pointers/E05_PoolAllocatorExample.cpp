@@ -9,6 +9,9 @@
  * contiguous block of memory large enough for the allocation.
  */
 #include "pch.h"
+#include <atomic>
+#include <thread>
+#include <vector>
 #include "Allocators/PoolAllocator.h"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -42,6 +45,24 @@ namespace Pointers
             int z;
         };
 
+        // A type that needs a larger alignment than the pool's next pointer, similar to an SSE
+        // vector.
+        struct alignas(16) Vector4
+        {
+            Vector4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+            float x, y, z, w;
+        };
+
+        // A counter that each thread updates and so wants to live on its own cache line.
+        struct Counter
+        {
+            Counter() : value(0) {}
+            long long value;
+        };
+
+        typedef PoolAllocator<Tank, 3> TankPool;
+        static TankPool s_tankPool;
+
     public:
         TEST_METHOD(Direct_Pool_Usage)
         {
@@ -119,5 +140,389 @@ namespace Pointers
             Assert::AreEqual(3u, pool.getFreeCount());
             Assert::AreEqual(0u, pool.getAllocCount());
         }
+
+        TEST_METHOD(Over_Aligned_Types)
+        {
+            // Items are always placed at a suitably aligned address, even when the type needs a
+            // larger alignment than the pool's own book keeping.
+            PoolAllocator<Vector4, 4> pool;
+            for (int i = 0; i < 4; i++)
+            {
+                Vector4* pVec = pool.construct(1.0f, 2.0f, 3.0f, 4.0f);
+                Assert::AreEqual((uintptr_t)0, reinterpret_cast<uintptr_t>(pVec) % alignof(Vector4), L"Item is not correctly aligned");
+            }
+        }
+
+        TEST_METHOD(Cache_Line_Padding)
+        {
+            // By default the slots are packed as tightly as the alignment rules allow.
+            Assert::AreEqual((size_t)16, PoolAllocator<Counter, 4>::getSlotSize());
+
+            // Slots can be padded out so that no two items share a cache line. This is useful for
+            // items that are going to be updated by different threads.
+            typedef PoolAllocator<Counter, 4, POOL_CACHE_LINE_ALIGNED> PaddedPool;
+            Assert::AreEqual((size_t)64, PaddedPool::getSlotSize());
+
+            PaddedPool pool;
+            Counter* c1 = pool.construct();
+            Counter* c2 = pool.construct();
+            auto line1 = reinterpret_cast<uintptr_t>(c1) / 64;
+            auto line2 = reinterpret_cast<uintptr_t>(c2) / 64;
+            Assert::AreNotEqual(line1, line2, L"Items should be on different cache lines");
+
+            // Validation still works with the extra padding.
+            pool.destruct(c1);
+            AssertThrows<std::invalid_argument>([&pool, c1]() {
+                pool.destruct(c1);
+            }, L"It should not be possible to double destruct element from pool");
+            pool.destruct(c2);
+        }
+
+        TEST_METHOD(For_Each_Live)
+        {
+            // The pool tracks which slots are in use, so we can visit every live item without
+            // having to keep our own list of them.
+            PoolAllocator<Tank, 200> pool;
+            std::vector<Tank*> tanks;
+            for (int i = 0; i < 200; i++)
+                tanks.push_back(pool.construct(i, 0, 0));
+
+            // Release everything except every 50th tank, leaving large runs of empty slots.
+            for (int i = 0; i < 200; i++)
+                if (i % 50 != 0) pool.destruct(tanks[i]);
+
+            int count = 0;
+            int total = 0;
+            const Tank* pPrevious = nullptr;
+            pool.for_each_live([&](Tank& tank) {
+                // Items are visited in address order.
+                Assert::IsTrue(pPrevious == nullptr || pPrevious < &tank, L"Items should be visited in address order");
+                pPrevious = &tank;
+                count++;
+                total += tank.check();
+            });
+            Assert::AreEqual(4, count);
+            Assert::AreEqual(0 + 50 + 100 + 150, total);
+
+            // Live items can be updated in place as we go.
+            pool.for_each_live([](Tank& tank) { tank.y = 1; });
+            total = 0;
+            const auto& constPool = pool;
+            constPool.for_each_live([&total](const Tank& tank) { total += tank.y; });
+            Assert::AreEqual(4, total);
+        }
+
+        TEST_METHOD(Bulk_Construct_And_Destruct)
+        {
+            PoolAllocator<Tank, 5> pool;
+
+            // Several items can be constructed in one call, all from the same arguments.
+            Tank* tanks[4];
+            pool.construct_n(tanks, 4, 1, 2, 3);
+            Assert::AreEqual(4u, pool.getAllocCount());
+            for (auto pTank : tanks)
+                Assert::AreEqual(6, pTank->check());
+
+            // Bulk construction is all or nothing. There is only room for one more item so asking
+            // for two fails without allocating anything.
+            Tank* moreTanks[2];
+            AssertThrows<std::bad_alloc>([&pool, &moreTanks]() {
+                pool.construct_n(moreTanks, 2);
+            }, L"Bulk construction should fail when there is not room for every item");
+            Assert::AreEqual(4u, pool.getAllocCount());
+
+            // Bulk destruction verifies every item before releasing any of them. Here the second
+            // item is repeated so the request is rejected and all four remain allocated.
+            Tank* duplicates[] = { tanks[0], tanks[1], tanks[1] };
+            AssertThrows<std::invalid_argument>([&pool, &duplicates]() {
+                pool.destruct_n(duplicates, 3);
+            }, L"It should not be possible to destruct the same element twice");
+            Assert::AreEqual(4u, pool.getAllocCount());
+
+            pool.destruct_n(tanks, 4);
+            Assert::AreEqual(0u, pool.getAllocCount());
+            Assert::AreEqual(5u, pool.getFreeCount());
+
+            // All of the slots are usable again afterwards.
+            Tank* allTanks[5];
+            pool.construct_n(allTanks, 5);
+            Assert::AreEqual(0u, pool.getFreeCount());
+            pool.destruct_n(allTanks, 5);
+        }
+
+        TEST_METHOD(Bulk_Construct_Failure)
+        {
+            // An item that throws from its constructor part way through a bulk construction.
+            struct Fragile
+            {
+                Fragile(int* pConstructed, int* pDestructed) :
+                    pDestructed(pDestructed)
+                {
+                    if (++*pConstructed == 3) throw std::runtime_error("Construction failed");
+                }
+
+                ~Fragile() { ++*pDestructed; }
+
+                int* pDestructed;
+            };
+            int constructed = 0;
+            int destructed = 0;
+
+            PoolAllocator<Fragile, 4, 0, FullPoolChecks> pool;
+            Fragile* items[4];
+            AssertThrows<std::runtime_error>([&]() {
+                pool.construct_n(items, 4, &constructed, &destructed);
+            }, L"The constructor exception should be passed on");
+
+            // The two items that were constructed are destructed again and every slot is free.
+            Assert::AreEqual(2, destructed);
+            Assert::AreEqual(4u, pool.getFreeCount());
+            int live = 0;
+            pool.for_each_live([&live](Fragile&) { live++; });
+            Assert::AreEqual(0, live);
+
+            // The slots are poisoned on the way back, so they can be used again straight away
+            // without looking like they were written to after being released.
+            for (int i = 0; i < 4; i++)
+                items[i] = pool.construct(&constructed, &destructed);
+            Assert::AreEqual(0u, pool.getFreeCount());
+            pool.destruct_n(items, 4);
+        }
+
+        TEST_METHOD(Reset)
+        {
+            // Resetting a pool releases everything in one go without calling any destructors.
+            // This is useful for per-frame or per-request pools that are thrown away as a whole.
+            PoolAllocator<Tank, 100> pool;
+            Tank* first = pool.construct(1, 1, 1);
+            Tank* stale = pool.construct(1, 1, 1);
+            for (int i = 0; i < 8; i++)
+                pool.construct(i, i, i);
+            pool.destruct(first);
+            Assert::AreEqual(9u, pool.getAllocCount());
+
+            // Reset doesn't need to visit every slot. Slots that have never been used are handed
+            // out in order as needed, so the cost doesn't depend on the size of the pool.
+            pool.reset();
+            Assert::AreEqual(0u, pool.getAllocCount());
+            Assert::AreEqual(100u, pool.getFreeCount());
+            int live = 0;
+            pool.for_each_live([&live](Tank&) { live++; });
+            Assert::AreEqual(0, live);
+
+            // Anything allocated before the reset is gone, so releasing it is an error.
+            AssertThrows<std::invalid_argument>([&pool, stale]() {
+                pool.destruct(stale);
+            }, L"It should not be possible to destruct an element from before a reset");
+            Assert::AreEqual(0u, pool.getAllocCount());
+
+            // After a reset, allocation starts from the beginning of the pool again.
+            AssertAreSame(first, pool.construct(2, 2, 2));
+            AssertThrows<std::invalid_argument>([&pool, stale]() {
+                pool.destruct(stale);
+            }, L"It should not be possible to destruct an element from before a reset");
+
+            // And the whole pool is still available.
+            for (int i = 0; i < 99; i++)
+                pool.construct(i, i, i);
+            Assert::AreEqual(0u, pool.getFreeCount());
+        }
+
+        TEST_METHOD(Check_Policies)
+        {
+            Tank invalidAllocation;
+
+            // By default, release requests are checked for being in range and for double releases.
+            PoolAllocator<Tank, 2, 0, DefaultPoolChecks> defaultPool;
+            AssertThrows<std::invalid_argument>([&defaultPool, &invalidAllocation]() {
+                defaultPool.destruct(&invalidAllocation);
+            }, L"It should not be possible to destruct element not from pool");
+
+            // The range check on its own is cheaper but can't spot double releases.
+            PoolAllocator<Tank, 2, 0, RangePoolChecks> rangePool;
+            AssertThrows<std::invalid_argument>([&rangePool, &invalidAllocation]() {
+                rangePool.destruct(&invalidAllocation);
+            }, L"It should not be possible to destruct element not from pool");
+
+            // The checks can be turned off completely for the fastest possible release. It's then
+            // up to the caller to only ever pass valid pointers.
+            PoolAllocator<Tank, 2, 0, NoPoolChecks> uncheckedPool;
+            uncheckedPool.destruct(uncheckedPool.construct(1, 2, 3));
+            Assert::AreEqual(0u, uncheckedPool.getAllocCount());
+
+            // The full checks also poison released slots. If anything writes to a slot after it
+            // has been released, it's spotted when the slot is next allocated.
+            PoolAllocator<Tank, 2, 0, FullPoolChecks> fullPool;
+            Tank* pTank = fullPool.construct(1, 2, 3);
+            fullPool.destruct(pTank);
+            Assert::AreEqual((int)0xDDDDDDDD, pTank->x, L"Released slot should have been poisoned");
+
+            pTank->y = 5;
+            AssertThrows<std::logic_error>([&fullPool]() {
+                fullPool.construct(4, 5, 6);
+            }, L"Writing to a released slot should be detected");
+        }
+
+        TEST_METHOD(Free_List_Order)
+        {
+            // Release the second, fourth and then first items from a full pool and record which
+            // slots are handed out again, in order.
+            auto churn = [](auto& pool, size_t* pSlots) {
+                Tank* pTanks[4];
+                for (auto& pTank : pTanks)
+                    pTank = pool.construct();
+                pool.destruct(pTanks[1]);
+                pool.destruct(pTanks[3]);
+                pool.destruct(pTanks[0]);
+                auto pBase = reinterpret_cast<char*>(pTanks[0]);
+                for (int i = 0; i < 3; i++)
+                    pSlots[i] = (reinterpret_cast<char*>(pool.construct()) - pBase) / pool.getSlotSize();
+            };
+            size_t slots[3];
+
+            // By default, the most recently released slot is reused first.
+            PoolAllocator<Tank, 4, 0, DefaultPoolChecks, LifoFreeList> lifoPool;
+            churn(lifoPool, slots);
+            AssertArrayEqual({ 0, 3, 1 }, slots, 3);
+
+            PoolAllocator<Tank, 4, 0, DefaultPoolChecks, FifoFreeList> fifoPool;
+            churn(fifoPool, slots);
+            AssertArrayEqual({ 1, 3, 0 }, slots, 3);
+
+            // Address ordered always hands out the lowest free slot, keeping the items in the same
+            // order in memory as they were allocated in.
+            PoolAllocator<Tank, 4, 0, DefaultPoolChecks, AddressOrderedFreeList> orderedPool;
+            churn(orderedPool, slots);
+            AssertArrayEqual({ 0, 1, 3 }, slots, 3);
+        }
+
+        TEST_METHOD(Telemetry)
+        {
+            // Telemetry is off by default and costs nothing. Turning it on gives us counters that
+            // can be used to size the pool from real usage.
+            PoolAllocator<Tank, 3, 0, DefaultPoolChecks, LifoFreeList, PoolTelemetry> pool;
+            PoolStats start = pool.getStats();
+
+            auto t1 = pool.construct(1, 2, 3);
+            auto t2 = pool.construct(4, 5, 6);
+            pool.destruct(t1);
+            Tank* tanks[2];
+            pool.construct_n(tanks, 2, 7, 8, 9);
+            AssertThrows<std::bad_alloc>([&pool]() {
+                pool.construct();
+            }, L"No more allocations should be possible from pool");
+            pool.destruct_n(tanks, 2);
+            pool.destruct(t2);
+
+            PoolStats stats = pool.getStats();
+            Assert::AreEqual((size_t)3, stats.high_water_mark);
+            Assert::AreEqual((uint64_t)4, stats.allocations);
+            Assert::AreEqual((uint64_t)4, stats.frees);
+            Assert::AreEqual((uint64_t)1, stats.failed_allocations);
+            Assert::IsTrue(stats.allocationRateSince(start) >= 0);
+        }
+
+        TEST_METHOD(Remote_Frees)
+        {
+            // Items are constructed on this thread, which owns the pool, and released on others.
+            const int count = 1000;
+            static PoolAllocator<Tank, count, 0, DefaultPoolChecks, LifoFreeList, NoPoolTelemetry, RemoteFrees> pool;
+            std::vector<Tank*> tanks;
+            for (int i = 0; i < count; i++)
+                tanks.push_back(pool.construct(i, 0, 0));
+
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 4; t++)
+            {
+                threads.emplace_back([&tanks, t]() {
+                    for (size_t i = t; i < tanks.size(); i += 4)
+                        pool.destruct_remote(tanks[i]);
+                });
+            }
+            for (auto& thread : threads) thread.join();
+
+            // The slots aren't handed back until this thread next uses the pool.
+            Assert::AreEqual(0u, pool.getFreeCount());
+            Tank* pReused = pool.construct(0, 0, 0);
+            Assert::AreEqual((unsigned int)count - 1, pool.getFreeCount());
+
+            // The usual release validation still applies.
+            Tank* pReleased = tanks[0] != pReused ? tanks[0] : tanks[1];
+            AssertThrows<std::invalid_argument>([pReleased]() {
+                pool.destruct_remote(pReleased);
+            }, L"It should not be possible to double destruct element from pool");
+        }
+
+        TEST_METHOD(Remote_Frees_While_Constructing)
+        {
+            // A producer/consumer pipeline. This thread keeps constructing items in a pool far
+            // smaller than the number of items, handing each one to a consumer thread which
+            // releases it while this thread carries on constructing.
+            const int CONSUMERS = 4;
+            const int ITEMS = 20000;
+            static PoolAllocator<Tank, 64, 0, FullPoolChecks, LifoFreeList, NoPoolTelemetry, RemoteFrees> pool;
+            std::vector<std::atomic<Tank*>> handoff(ITEMS);
+            for (auto& pItem : handoff)
+                pItem.store(nullptr, std::memory_order_relaxed);
+
+            std::atomic<int> checked(0);
+            std::vector<std::thread> consumers;
+            for (int t = 0; t < CONSUMERS; t++)
+            {
+                consumers.emplace_back([&handoff, &checked, t]() {
+                    for (int i = t; i < ITEMS; i += CONSUMERS)
+                    {
+                        Tank* pTank;
+                        while ((pTank = handoff[i].load(std::memory_order_acquire)) == nullptr)
+                            std::this_thread::yield();
+                        if (pTank->check() == i) checked++;
+                        pool.destruct_remote(pTank);
+                    }
+                });
+            }
+
+            for (int i = 0; i < ITEMS; i++)
+            {
+                Tank* pTank = nullptr;
+                while (pTank == nullptr)
+                {
+                    // When the pool is full, wait for the consumers to release something.
+                    try
+                    {
+                        pTank = pool.construct(i, 0, 0);
+                    }
+                    catch (const std::bad_alloc&)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+                handoff[i].store(pTank, std::memory_order_release);
+            }
+            for (auto& consumer : consumers) consumer.join();
+
+            // Every item arrived intact and every slot comes back.
+            Assert::AreEqual(ITEMS, checked.load());
+            pool.destruct(pool.construct(0, 0, 0));
+            Assert::AreEqual(0u, pool.getAllocCount());
+        }
+
+        TEST_METHOD(Static_Pool_Binding)
+        {
+            // A pool's unique_ptr has to carry a pointer to the pool around with it, so it's twice
+            // the size of a raw pointer.
+            Assert::AreEqual(2 * sizeof(Tank*), sizeof(TankPool::unique_ptr));
+
+            // When the pool has static storage duration it can be bound at compile time instead,
+            // and the unique_ptr is back to the size of a raw pointer.
+            static_assert(sizeof(TankPool::static_unique_ptr<s_tankPool>) == sizeof(Tank*), "Statically bound unique_ptr should be pointer sized");
+            {
+                auto t1 = TankPool::make_static_unique<s_tankPool>(1, 2, 3);
+                Assert::AreEqual(6, t1->check());
+                Assert::AreEqual(1u, s_tankPool.getAllocCount());
+            }
+            Assert::AreEqual(0u, s_tankPool.getAllocCount());
+        }
     };
-}
\ No newline at end of file
+
+    E05_PooledAllocatorExample::TankPool E05_PooledAllocatorExample::s_tankPool;
+}